@@ -0,0 +1,58 @@
+"""
+Decoder for the binary event log written by the Verilator test drivers
+(--event-log <file>). The format is described in verilator/tb_log.h.
+
+    python tb_event_log.py events.bin [--event io_to_cgra_rd] [--channel 0]
+"""
+import argparse
+import struct
+
+MAGIC = b"TBEVLOG1"
+EVENT = struct.Struct("<HHIQQ")
+DEFINITION = struct.Struct("<HB")
+
+
+def read_events(filename):
+    """
+    Yields (cycle, name, channel, addr, data) for every event in the log.
+    """
+    names = {}
+    with open(filename, "rb") as f:
+        if f.read(len(MAGIC)) != MAGIC:
+            raise ValueError(f"{filename} is not an event log")
+        while True:
+            kind = f.read(1)
+            if not kind:
+                break
+            if kind == b"D":
+                event_id, length = DEFINITION.unpack(f.read(DEFINITION.size))
+                names[event_id] = f.read(length).decode()
+            elif kind == b"E":
+                buf = f.read(EVENT.size)
+                if len(buf) < EVENT.size:
+                    break   # truncated by a crash
+                event_id, channel, addr, cycle, data = EVENT.unpack(buf)
+                yield (cycle, names.get(event_id, str(event_id)), channel,
+                       addr, data)
+            else:
+                raise ValueError(f"corrupted record {kind!r} in {filename}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip())
+    parser.add_argument("filename")
+    parser.add_argument("--event", help="only print events with this name")
+    parser.add_argument("--channel", type=int,
+                        help="only print events of this channel")
+    args = parser.parse_args()
+    for cycle, name, channel, addr, data in read_events(args.filename):
+        if args.event is not None and name != args.event:
+            continue
+        if args.channel is not None and channel != args.channel:
+            continue
+        print(f"{cycle:>10} {name:<20} {channel:>3} 0x{addr:08x} "
+              f"0x{data:016x}")
+
+
+if __name__ == "__main__":
+    main()
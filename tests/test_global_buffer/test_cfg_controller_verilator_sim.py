@@ -1,34 +1,167 @@
 import glob
+import json
 import pytest
 import os
+import random
 from gemstone.common.run_genesis import run_genesis
-from verilator_sim import run_verilator, verilator_available
+from verilator_sim import compiler_available, run_model, run_verilator, \
+    verilator_available, work_dir
+
+
+# Test drivers and RTL parameters shared by the tests below
+DRIVER_DIR = "tests/test_global_buffer/verilator/"
+TEST_DRIVER = DRIVER_DIR + "test_cfg_controller.cpp"
+SPEED_DRIVER = DRIVER_DIR + "speed_cfg_controller.cpp"
+PLAN_DRIVER = DRIVER_DIR + "plan_cfg_controller.cpp"
+VERILOG_PARAMS = {
+    "BANK_DATA_WIDTH": 64,
+    "GLB_ADDR_WIDTH": 22
+}
 
 
 def run_verilator_regression(top, test_driver, genesis_params={},
-                             verilog_params={}):
-    # Genesis version of global_controller
-    run_genesis(f"{top}",
-                ["global_buffer/genesis/cfg_address_generator.svp",
-                 "global_buffer/genesis/cfg_controller.svp"],
-                genesis_params)
-    files = []
-    files.extend(glob.glob('genesis_verif/cfg_address_generator.sv'))
-    files.extend(glob.glob('genesis_verif/cfg_controller.sv'))
-    return run_verilator(verilog_params, top, files, test_driver)
+                             verilog_params={}, threads=1, args={},
+                             seeds=None, log_level=None):
+    with work_dir(top, test_driver, genesis_params, verilog_params,
+                  threads, args, log_level) as root:
+        # Genesis version of global_controller
+        run_genesis(f"{top}",
+                    [os.path.join(root, f) for f in
+                     ["global_buffer/genesis/cfg_address_generator.svp",
+                      "global_buffer/genesis/cfg_controller.svp"]],
+                    genesis_params)
+        files = []
+        files.extend(glob.glob('genesis_verif/cfg_address_generator.sv'))
+        files.extend(glob.glob('genesis_verif/cfg_controller.sv'))
+        return run_verilator(verilog_params, top, files,
+                             os.path.join(root, test_driver),
+                             threads=threads, args=args, seeds=seeds,
+                             log_level=log_level)
 
 
 @pytest.mark.skipif(not verilator_available(),
                     reason="verilator not available")
-@pytest.mark.parametrize('verilog_params', [
-    {
-        "BANK_DATA_WIDTH": 64,
-        "GLB_ADDR_WIDTH": 22
-    }
-])
+@pytest.mark.parametrize('verilog_params', [VERILOG_PARAMS])
 def test_cfg_controller_verilator(verilog_params):
-    test_driver = f"tests/test_global_buffer/verilator/"\
-                  f"test_cfg_controller.cpp"
-    res = run_verilator_regression("cfg_controller", test_driver,
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
                                    {}, verilog_params)
     assert res == 1
+
+
+# The regression on the fast clock, checked against a second model on the
+# full clock in lockstep
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_cfg_controller_clock_lockstep():
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--clock": "lockstep"})
+    assert res == 1
+
+
+# Parallel configuration of a bitstream in the garnet.py --output format.
+# The driver prints the configuration cycles and words/cycle for 1, 2, 4
+# and 8 channels.
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_cfg_controller_bitstream(tmp_path):
+    rng = random.Random(0)
+    bitstream = tmp_path / "bitstream.bs"
+    bitstream.write_text("\n".join(
+        f"{rng.getrandbits(32):08X} {rng.getrandbits(32):08X}"
+        for _ in range(1000)))
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--bitstream": str(bitstream)})
+    assert res == 1
+
+
+# The regression with every output checked against CFG_CTRL_MODEL
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_cfg_controller_model():
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--model": 1})
+    assert res == 1
+
+
+# How a bitstream splits over the channels, on the C++ model alone. The
+# driver prints the configuration cycles of every plan.
+@pytest.mark.skipif(not compiler_available(),
+                    reason="C++ compiler not available")
+def test_cfg_controller_model_plan(tmp_path):
+    rng = random.Random(0)
+    bitstream = tmp_path / "bitstream.bs"
+    bitstream.write_text("\n".join(
+        f"{rng.getrandbits(32):08X} {rng.getrandbits(32):08X}"
+        for _ in range(100000)))
+    res = run_model(PLAN_DRIVER, args={"GLB_ADDR_WIDTH": 22,
+                                       "--bitstream": str(bitstream)})
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) of a multithreaded
+# model
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('threads', [1, 2, 4, 8])
+def test_cfg_controller_threads_speed(threads):
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS, threads=threads,
+                                   args={"--trace": 0})
+    assert res == 1
+
+
+# Randomized regression over many seeds at once. Failing seeds are printed
+# and can be replayed with args={"--seed": seed}.
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_cfg_controller_seed_sweep():
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--record": 1000},
+                                   seeds=range(64))
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) with the per-cycle
+# messages printed, filtered at runtime and compiled out
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('log_level,verbosity', [
+    (None, 2),
+    (None, 1),
+    (1, 1),
+])
+def test_cfg_controller_log_speed(log_level, verbosity):
+    res = run_verilator_regression("cfg_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--verbosity": verbosity},
+                                   log_level=log_level)
+    assert res == 1
+
+
+# Simulator throughput in cycles/s of fixed workloads with tracing and checks
+# off and on, 3 repetitions each (see speed_cfg_controller.cpp),
+# written to a JSON file to compare builds
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_cfg_controller_speed_bench(tmp_path):
+    json_file = tmp_path / "speed.json"
+    res = run_verilator_regression("cfg_controller", SPEED_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--reps": 3,
+                                         "--json": str(json_file)})
+    assert res == 1
+    with open(json_file) as f:
+        results = json.load(f)["results"]
+    assert {r["workload"] for r in results} == {"stream", "jtag"}
+    assert len(results) == 4 * len({r["workload"] for r in results})
+    assert all(len(r["rates"]) == 3 for r in results)
@@ -1,55 +1,275 @@
 import glob
+import json
 import pytest
 import os
 from gemstone.common.run_genesis import run_genesis
-from verilator_sim import run_verilator, verilator_available
+from verilator_sim import run_verilator, verilator_available, work_dir
+
+
+# Test drivers and RTL parameters shared by the tests below
+DRIVER_DIR = "tests/test_global_buffer/verilator/"
+TEST_DRIVER = DRIVER_DIR + "test_global_buffer_int.cpp"
+SPEED_DRIVER = DRIVER_DIR + "speed_global_buffer_int.cpp"
+BENCH_DRIVER = DRIVER_DIR + "bench_global_buffer_int.cpp"
+VERILOG_PARAMS = {
+    "BANK_DATA_WIDTH": 64,
+    "GLB_ADDR_WIDTH": 32,
+    "CGRA_DATA_WIDTH": 16
+}
 
 
 def run_verilator_regression(top, test_driver, genesis_params={},
-                             verilog_params={}):
-    # Genesis version of global_controller
-    run_genesis(f"{top}",
-                ["global_buffer/genesis/bank_controller.svp",
-                 "global_buffer/genesis/cfg_address_generator.svp",
-                 "global_buffer/genesis/cfg_controller.svp",
-                 "global_buffer/genesis/glbuf_memory_core.svp",
-                 "global_buffer/genesis/global_buffer_int.svp",
-                 "global_buffer/genesis/host_bank_interconnect.svp",
-                 "global_buffer/genesis/io_address_generator.svp",
-                 "global_buffer/genesis/io_controller.svp",
-                 "global_buffer/genesis/memory_bank.svp",
-                 "global_buffer/genesis/memory.svp",
-                 "global_buffer/genesis/sram_controller.svp",
-                 "global_buffer/genesis/sram_gen.svp"],
-                genesis_params)
-    files = ["genesis_verif/bank_controller.sv",
-             "genesis_verif/cfg_address_generator.sv",
-             "genesis_verif/cfg_controller.sv",
-             "genesis_verif/glbuf_memory_core.sv",
-             "genesis_verif/global_buffer_int.sv",
-             "genesis_verif/host_bank_interconnect.sv",
-             "genesis_verif/io_address_generator.sv",
-             "genesis_verif/io_controller.sv",
-             "genesis_verif/memory_bank.sv",
-             "genesis_verif/memory.sv",
-             "genesis_verif/sram_controller.sv",
-             "genesis_verif/sram_gen.sv",
-             "global_buffer/genesis/TS1N16FFCLLSBLVTC2048X64M8SW.sv"]
-    return run_verilator(verilog_params, top, files, test_driver)
-
-
-@pytest.mark.skipif(not verilator_available(),
-                    reason="verilator not available")
-@pytest.mark.parametrize('verilog_params', [
-    {
-        "BANK_DATA_WIDTH": 64,
-        "GLB_ADDR_WIDTH": 32,
-        "CGRA_DATA_WIDTH": 16
-    }
-])
+                             verilog_params={}, trace="vcd", trace_threads=0,
+                             threads=1, args={}, seeds=None, log_level=None,
+                             savable=False):
+    with work_dir(top, test_driver, genesis_params, verilog_params, trace,
+                  trace_threads, threads, args, log_level, savable) as root:
+        # Genesis version of global_controller
+        run_genesis(f"{top}",
+                    [os.path.join(root, f) for f in
+                     ["global_buffer/genesis/bank_controller.svp",
+                      "global_buffer/genesis/cfg_address_generator.svp",
+                      "global_buffer/genesis/cfg_controller.svp",
+                      "global_buffer/genesis/glbuf_memory_core.svp",
+                      "global_buffer/genesis/global_buffer_int.svp",
+                      "global_buffer/genesis/host_bank_interconnect.svp",
+                      "global_buffer/genesis/io_address_generator.svp",
+                      "global_buffer/genesis/io_controller.svp",
+                      "global_buffer/genesis/memory_bank.svp",
+                      "global_buffer/genesis/memory.svp",
+                      "global_buffer/genesis/sram_controller.svp",
+                      "global_buffer/genesis/sram_gen.svp"]],
+                    genesis_params)
+        files = ["genesis_verif/bank_controller.sv",
+                 "genesis_verif/cfg_address_generator.sv",
+                 "genesis_verif/cfg_controller.sv",
+                 "genesis_verif/glbuf_memory_core.sv",
+                 "genesis_verif/global_buffer_int.sv",
+                 "genesis_verif/host_bank_interconnect.sv",
+                 "genesis_verif/io_address_generator.sv",
+                 "genesis_verif/io_controller.sv",
+                 "genesis_verif/memory_bank.sv",
+                 "genesis_verif/memory.sv",
+                 "genesis_verif/sram_controller.sv",
+                 "genesis_verif/sram_gen.sv",
+                 os.path.join(root, "global_buffer/genesis/"
+                              "TS1N16FFCLLSBLVTC2048X64M8SW.sv"),
+                 # internal signals the testbench reads
+                 os.path.join(root, "tests/test_global_buffer/verilator/"
+                              "global_buffer_int.vlt")]
+        return run_verilator(verilog_params, top, files,
+                             os.path.join(root, test_driver),
+                             trace=trace, trace_threads=trace_threads,
+                             threads=threads, args=args, seeds=seeds,
+                             log_level=log_level, savable=savable)
+
+
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('verilog_params', [VERILOG_PARAMS])
 def test_global_buffer_int_verilator(verilog_params):
-    test_driver = f"tests/test_global_buffer/verilator/"\
-                  f"test_global_buffer_int.cpp"
-    res = run_verilator_regression("global_buffer_int", test_driver,
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
                                    {}, verilog_params)
     assert res == 1
+
+
+# Compare simulation speed (printed by the driver in cycles/s) without
+# tracing, with VCD, with FST and with FST encoded on a separate thread.
+# The driver also prints how the time splits between model, golden model,
+# trace dumping and itself.
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('trace,trace_threads,args', [
+    ("vcd", 0, {"--trace": 0}),
+    ("vcd", 0, {}),
+    ("fst", 0, {}),
+    ("fst", 1, {}),
+])
+def test_global_buffer_int_trace_speed(trace, trace_threads, args):
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS, trace=trace,
+                                   trace_threads=trace_threads,
+                                   args={**args, "--perf": 1})
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) of a multithreaded
+# model
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('threads', [1, 2, 4, 8])
+def test_global_buffer_int_threads_speed(threads):
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS, threads=threads,
+                                   args={"--trace": 0})
+    assert res == 1
+
+
+# Randomized regression over many seeds at once. Failing seeds are printed
+# and can be replayed with args={"--seed": seed}.
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_seed_sweep():
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--record": 1000},
+                                   seeds=range(64))
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) with the per-cycle
+# messages printed, filtered at runtime and compiled out
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('log_level,verbosity', [
+    (None, 2),
+    (None, 1),
+    (1, 1),
+])
+def test_global_buffer_int_log_speed(log_level, verbosity):
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--verbosity": verbosity},
+                                   log_level=log_level)
+    assert res == 1
+
+
+# Sustained bytes/cycle and read latency of every access path, pattern and
+# channel count (see bench_global_buffer_int.cpp), written to a JSON file
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_bandwidth(tmp_path):
+    json_file = tmp_path / "bandwidth.json"
+    bank_stats_file = tmp_path / "bank_stats.json"
+    res = run_verilator_regression("global_buffer_int", BENCH_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--json": str(json_file),
+                                         "--bank-stats": str(bank_stats_file)})
+    assert res == 1
+    with open(json_file) as f:
+        results = json.load(f)["results"]
+    assert {r["path"] for r in results} >= {"host_wr", "host_rd", "io_rd",
+                                            "sram_config_rd", "cfg"}
+    with open(bank_stats_file) as f:
+        bank_stats = json.load(f)
+    assert len(bank_stats["requests"]) == bank_stats["banks"]
+    assert all(len(row) == len(bank_stats["requesters"])
+               for row in bank_stats["requests"])
+
+
+# Record the CGRA side traffic of the CGRA tests and play it back into a
+# fresh model, which checks io_to_cgra_rd_data again
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_io_replay(tmp_path):
+    io_trace = str(tmp_path / "io")
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--rd-en": "bursty:0.5:8",
+                                         "--io-trace": io_trace})
+    assert res == 1
+    assert os.path.getsize(io_trace + "_sram.bin") > 0
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--io-replay": io_trace})
+    assert res == 1
+
+
+# Simulator throughput in cycles/s of fixed workloads with tracing and checks
+# off and on, 3 repetitions each (see speed_global_buffer_int.cpp),
+# written to a JSON file to compare builds
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_speed_bench(tmp_path):
+    json_file = tmp_path / "speed.json"
+    res = run_verilator_regression("global_buffer_int", SPEED_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--reps": 3,
+                                         "--json": str(json_file)})
+    assert res == 1
+    with open(json_file) as f:
+        results = json.load(f)["results"]
+    assert {r["workload"] for r in results} == {"instream", "cfg",
+                                                "host"}
+    assert len(results) == 4 * len({r["workload"] for r in results})
+    assert all(len(r["rates"]) == 3 for r in results)
+
+
+# The whole regression on the fast clock, with a second model on the full
+# clock in lockstep that has to agree on every port every cycle
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_clock_lockstep():
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--clock": "lockstep"})
+    assert res == 1
+
+
+# Throughput of the speed benchmark on the full and on the fast clock. The
+# gain of every workload is printed, cycles/s fast over full.
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_clock_speed(tmp_path):
+    means = {}
+    for clock in ["full", "fast"]:
+        json_file = tmp_path / f"speed_{clock}.json"
+        res = run_verilator_regression("global_buffer_int", SPEED_DRIVER,
+                                       {}, VERILOG_PARAMS,
+                                       args={"--trace": 0, "--reps": 3,
+                                             "--clock": clock,
+                                             "--json": str(json_file)})
+        assert res == 1
+        with open(json_file) as f:
+            speed = json.load(f)
+        assert speed["clock"] == clock
+        means[clock] = {(r["workload"], r["check"]): r["mean"]
+                        for r in speed["results"]}
+    assert means["fast"].keys() == means["full"].keys()
+    for key, full in sorted(means["full"].items()):
+        print(f"{key[0]:<10} check={key[1]!s:<5} "
+              f"{full:12.0f} -> {means['fast'][key]:12.0f} c/s "
+              f"({means['fast'][key] / full:.2f}x)")
+
+
+# Configure once and save a checkpoint, then run the streaming tests of
+# several seeds from it
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_checkpoint(tmp_path):
+    checkpoint = str(tmp_path / "configured.ckpt")
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--checkpoint": checkpoint},
+                                   savable=True)
+    assert res == 1
+    assert os.path.getsize(checkpoint) > 0
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--restore": checkpoint},
+                                   seeds=range(4), savable=True)
+    assert res == 1
+
+
+# Configure once, then run the streaming tests of four seeds in children
+# forked from the configured model
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_global_buffer_int_fork():
+    res = run_verilator_regression("global_buffer_int", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--fork": 4})
+    assert res == 1
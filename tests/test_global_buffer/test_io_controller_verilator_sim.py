@@ -1,35 +1,166 @@
 import glob
+import json
 import pytest
 import os
 from gemstone.common.run_genesis import run_genesis
-from verilator_sim import run_verilator, verilator_available
+from verilator_sim import run_verilator, verilator_available, work_dir
+from verilator_sim import compiler_available, run_model
+
+
+# Test drivers and RTL parameters shared by the tests below
+DRIVER_DIR = "tests/test_global_buffer/verilator/"
+TEST_DRIVER = DRIVER_DIR + "test_io_controller.cpp"
+SPEED_DRIVER = DRIVER_DIR + "speed_io_controller.cpp"
+SWEEP_DRIVER = DRIVER_DIR + "sweep_io_controller.cpp"
+VERILOG_PARAMS = {
+    "BANK_DATA_WIDTH": 64,
+    "GLB_ADDR_WIDTH": 22,
+    "CGRA_DATA_WIDTH": 16
+}
 
 
 def run_verilator_regression(top, test_driver, genesis_params={},
-                             verilog_params={}):
-    # Genesis version of global_controller
-    run_genesis(f"{top}",
-                ["global_buffer/genesis/io_address_generator.svp",
-                 "global_buffer/genesis/io_controller.svp"],
-                genesis_params)
-    files = []
-    files.extend(glob.glob('genesis_verif/io_address_generator.sv'))
-    files.extend(glob.glob('genesis_verif/io_controller.sv'))
-    return run_verilator(verilog_params, top, files, test_driver)
-
-
-@pytest.mark.skipif(not verilator_available(),
-                    reason="verilator not available")
-@pytest.mark.parametrize('verilog_params', [
-    {
-        "BANK_DATA_WIDTH": 64,
-        "GLB_ADDR_WIDTH": 22,
-        "CGRA_DATA_WIDTH": 16
-    }
-])
+                             verilog_params={}, threads=1, args={},
+                             seeds=None, log_level=None):
+    with work_dir(top, test_driver, genesis_params, verilog_params,
+                  threads, args, log_level) as root:
+        # Genesis version of global_controller
+        run_genesis(f"{top}",
+                    [os.path.join(root, f) for f in
+                     ["global_buffer/genesis/io_address_generator.svp",
+                      "global_buffer/genesis/io_controller.svp"]],
+                    genesis_params)
+        files = []
+        files.extend(glob.glob('genesis_verif/io_address_generator.sv'))
+        files.extend(glob.glob('genesis_verif/io_controller.sv'))
+        return run_verilator(verilog_params, top, files,
+                             os.path.join(root, test_driver),
+                             threads=threads, args=args, seeds=seeds,
+                             log_level=log_level)
+
+
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('verilog_params', [VERILOG_PARAMS])
 def test_io_controller_verilator(verilog_params):
-    test_driver = f"tests/test_global_buffer/verilator/"\
-                  f"test_io_controller.cpp"
-    res = run_verilator_regression("io_controller", test_driver,
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
                                    {}, verilog_params)
     assert res == 1
+
+
+# The regression on the fast clock, checked against a second model on the
+# full clock in lockstep
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_io_controller_clock_lockstep():
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--clock": "lockstep"})
+    assert res == 1
+
+
+# The regression with every output checked against IO_CTRL_MODEL
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_io_controller_model():
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--model": 1})
+    assert res == 1
+
+
+# INSTREAM, OUTSTREAM and SRAM over the whole address space on the C++
+# model alone, with stalls
+@pytest.mark.skipif(not compiler_available(),
+                    reason="C++ compiler not available")
+def test_io_controller_model_sweep():
+    res = run_model(SWEEP_DRIVER, args={"GLB_ADDR_WIDTH": 22,
+                                        "--stall": 0.2})
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) of a multithreaded
+# model
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('threads', [1, 2, 4, 8])
+def test_io_controller_threads_speed(threads):
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS, threads=threads,
+                                   args={"--trace": 0})
+    assert res == 1
+
+
+# Randomized regression over many seeds at once. Failing seeds are printed
+# and can be replayed with args={"--seed": seed}.
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_io_controller_seed_sweep():
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--record": 1000},
+                                   seeds=range(64))
+    assert res == 1
+
+
+# Simulation speed (printed by the driver in cycles/s) with the per-cycle
+# messages printed, filtered at runtime and compiled out
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('log_level,verbosity', [
+    (None, 2),
+    (None, 1),
+    (1, 1),
+])
+def test_io_controller_log_speed(log_level, verbosity):
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0,
+                                         "--verbosity": verbosity},
+                                   log_level=log_level)
+    assert res == 1
+
+
+# Effective throughput per channel (printed by the driver) against the stall
+# rate, for different shapes of glc_to_io_stall and CGRA write enable
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+@pytest.mark.parametrize('stall,wr_en', [
+    ("off", "on"),
+    ("periodic:4:1", "on"),
+    ("bernoulli:0.25", "on"),
+    ("bursty:0.25:16", "on"),
+    ("bernoulli:0.1", "bernoulli:0.5"),
+    ("bursty:0.5:32", "periodic:3:2"),
+])
+def test_io_controller_traffic(stall, wr_en):
+    res = run_verilator_regression("io_controller", TEST_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--trace": 0, "--stall": stall,
+                                         "--wr-en": wr_en})
+    assert res == 1
+
+
+# Simulator throughput in cycles/s of fixed workloads with tracing and checks
+# off and on, 3 repetitions each (see speed_io_controller.cpp),
+# written to a JSON file to compare builds
+@pytest.mark.longrun
+@pytest.mark.skipif(not verilator_available(),
+                    reason="verilator not available")
+def test_io_controller_speed_bench(tmp_path):
+    json_file = tmp_path / "speed.json"
+    res = run_verilator_regression("io_controller", SPEED_DRIVER,
+                                   {}, VERILOG_PARAMS,
+                                   args={"--reps": 3,
+                                         "--json": str(json_file)})
+    assert res == 1
+    with open(json_file) as f:
+        results = json.load(f)["results"]
+    assert {r["workload"] for r in results} == {"instream", "outstream"}
+    assert len(results) == 4 * len({r["workload"] for r in results})
+    assert all(len(r["rates"]) == 3 for r in results)
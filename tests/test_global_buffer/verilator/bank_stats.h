@@ -0,0 +1,151 @@
+#ifndef BANK_STATS_H
+#define BANK_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Requesters of a memory bank, highest priority first. SRAM config accesses
+// go straight to the memory core ahead of the bank controller, which serves
+// host writes, host reads, config stream reads, IO writes and IO reads in
+// that order.
+typedef enum REQUESTER {
+    REQ_SRAM_CONFIG = 0,
+    REQ_HOST_WR     = 1,
+    REQ_HOST_RD     = 2,
+    REQ_CFG_RD      = 3,
+    REQ_IO_WR       = 4,
+    REQ_IO_RD       = 5,
+    NUM_REQUESTERS  = 6
+} REQUESTER;
+
+const char *const REQUESTER_NAMES[] = {"sram_config", "host_wr", "host_rd", "cfg_rd", "io_wr", "io_rd"};
+
+// Per bank, per requester counters of the bank requests seen every cycle.
+// The banks have no grant or backpressure: a request which loses
+// arbitration is dropped, so blocked counts the cycles a requester lost.
+class BANK_STATS {
+public:
+    struct COUNTERS {
+        unsigned long   requests;   // cycles the requester asked for the bank
+        unsigned long   conflicts;  // ... while another requester did as well
+        unsigned long   blocked;    // ... while a higher priority one did
+    };
+
+    BANK_STATS(uint16_t num_banks) : m_counters(num_banks * NUM_REQUESTERS) {
+        m_num_banks = num_banks;
+        m_cycles = 0;
+    }
+
+    uint16_t num_banks(void) const {
+        return m_num_banks;
+    }
+
+    const COUNTERS &counters(uint16_t bank, REQUESTER requester) const {
+        return m_counters[bank * NUM_REQUESTERS + requester];
+    }
+
+    // Called once per cycle, before sample() of the banks
+    void cycle(void) {
+        m_cycles++;
+    }
+
+    // Requests of bank in this cycle, bit r set for requester r
+    void sample(uint16_t bank, uint8_t requests) {
+        if (requests == 0)
+            return;
+        bool conflict = (requests & (requests - 1)) != 0;
+        bool higher = false;
+        for (uint16_t r=0; r<NUM_REQUESTERS; r++) {
+            if (!((requests >> r) & 1))
+                continue;
+            COUNTERS &c = m_counters[bank * NUM_REQUESTERS + r];
+            c.requests++;
+            c.conflicts += conflict;
+            c.blocked += higher;
+            higher = true;
+        }
+    }
+
+    // One row per bank and requester
+    bool write_csv(const char *filename) const {
+        FILE *f = fopen(filename, "w");
+        if (f == NULL)
+            return false;
+        fprintf(f, "bank,requester,requests,conflicts,blocked\n");
+        for (uint16_t b=0; b<m_num_banks; b++) {
+            for (uint16_t r=0; r<NUM_REQUESTERS; r++) {
+                const COUNTERS &c = counters(b, (REQUESTER)r);
+                fprintf(f, "%u,%s,%lu,%lu,%lu\n", b, REQUESTER_NAMES[r],
+                        c.requests, c.conflicts, c.blocked);
+            }
+        }
+        fclose(f);
+        return true;
+    }
+
+    // Every counter as a matrix indexed by [bank][requester]
+    bool write_json(const char *filename) const {
+        FILE *f = fopen(filename, "w");
+        if (f == NULL)
+            return false;
+        fprintf(f, "{\n  \"cycles\": %lu,\n  \"banks\": %u,\n  \"requesters\": [", m_cycles, m_num_banks);
+        for (uint16_t r=0; r<NUM_REQUESTERS; r++)
+            fprintf(f, "%s\"%s\"", r ? ", " : "", REQUESTER_NAMES[r]);
+        fprintf(f, "]");
+        write_json_matrix(f, "requests", &COUNTERS::requests);
+        write_json_matrix(f, "conflicts", &COUNTERS::conflicts);
+        write_json_matrix(f, "blocked", &COUNTERS::blocked);
+        fprintf(f, "\n}\n");
+        fclose(f);
+        return true;
+    }
+
+    // JSON if filename ends in .json, CSV otherwise
+    bool write(const std::string &filename) const {
+        size_t n = filename.size();
+        if (n >= 5 && filename.compare(n - 5, 5, ".json") == 0)
+            return write_json(filename.c_str());
+        return write_csv(filename.c_str());
+    }
+
+    void print_summary(void) const {
+        unsigned long conflicts = 0, blocked = 0, hottest_blocked = 0;
+        uint16_t hottest = 0;
+        for (uint16_t b=0; b<m_num_banks; b++) {
+            unsigned long bank_blocked = 0;
+            for (uint16_t r=0; r<NUM_REQUESTERS; r++) {
+                conflicts += counters(b, (REQUESTER)r).conflicts;
+                bank_blocked += counters(b, (REQUESTER)r).blocked;
+            }
+            blocked += bank_blocked;
+            if (bank_blocked > hottest_blocked) {
+                hottest_blocked = bank_blocked;
+                hottest = b;
+            }
+        }
+        printf("Bank contention: %lu conflicting requests / %lu blocked", conflicts, blocked);
+        if (hottest_blocked > 0)
+            printf(" / hottest bank %u (%lu blocked)", hottest, hottest_blocked);
+        printf("\n");
+    }
+
+private:
+    uint16_t                m_num_banks;
+    unsigned long           m_cycles;
+    std::vector<COUNTERS>   m_counters;
+
+    void write_json_matrix(FILE *f, const char *name, unsigned long COUNTERS::*field) const {
+        fprintf(f, ",\n  \"%s\": [", name);
+        for (uint16_t b=0; b<m_num_banks; b++) {
+            fprintf(f, "%s\n    [", b ? "," : "");
+            for (uint16_t r=0; r<NUM_REQUESTERS; r++)
+                fprintf(f, "%s%lu", r ? ", " : "", counters(b, (REQUESTER)r).*field);
+            fprintf(f, "]");
+        }
+        fprintf(f, "\n  ]");
+    }
+};
+
+#endif
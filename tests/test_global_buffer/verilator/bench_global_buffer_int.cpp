@@ -0,0 +1,567 @@
+/*==============================================================================
+** Module: bench_global_buffer_int.cpp
+** Description: Bandwidth benchmark for Global Buffer
+** NOTE:    Every access path is driven back to back with a sequential,
+**          strided, cross-bank and random address pattern. The driver
+**          prints sustained bytes/cycle and read latency percentiles for
+**          each path, pattern and channel count, and writes them as JSON
+**          with --json <file>. Read data is still checked against the
+**          GLB shadow. --bank-stats <file> dumps how often the requesters
+**          of every bank collided (CSV, or JSON for a .json file).
+**          glb_sram_config reads have no valid signal to measure, they
+**          report the fixed latency of the RTL instead.
+**============================================================================*/
+
+#include "glb_tb.h"
+#include <algorithm>
+#include <deque>
+
+// Number of accesses per requester and run (--accesses)
+unsigned long NUM_ACCESSES = 4096;
+// Bytes between two accesses of the strided pattern
+uint32_t STRIDE = 256;
+
+typedef enum PATH
+{
+    PATH_HOST_WR            = 0,
+    PATH_HOST_RD            = 1,
+    PATH_SRAM_CONFIG_WR     = 2,
+    PATH_SRAM_CONFIG_RD     = 3,
+    PATH_IO_WR              = 4,
+    PATH_IO_RD              = 5,
+    PATH_CFG                = 6,
+    PATH_IO_HOST_RD         = 7
+} PATH;
+
+const char *PATH_NAMES[] = {"host_wr", "host_rd", "sram_config_wr", "sram_config_rd", "io_wr", "io_rd", "cfg", "io_rd+host_rd"};
+
+typedef enum PATTERN
+{
+    PAT_SEQUENTIAL  = 0,
+    PAT_STRIDED     = 1,
+    PAT_CROSS_BANK  = 2,
+    PAT_RANDOM      = 3
+} PATTERN;
+
+const char *PATTERN_NAMES[] = {"sequential", "strided", "cross_bank", "random"};
+
+struct BENCH_RESULT {
+    PATH                        path;
+    PATTERN                     pattern;
+    uint16_t                    channels;
+    unsigned long               accesses;
+    unsigned long               bytes;
+    unsigned long               cycles;
+    // cycles until the data of every read, empty for writes
+    std::vector<unsigned long>  latency;
+    // read latency set by the RTL instead of measured, 0 if there is none.
+    // glb_sram_config has no valid signal, reads are checked at the latency
+    // of the bank macro.
+    unsigned long               fixed_latency;
+};
+
+// Byte addresses of one requester, word_bytes wide and aligned, within
+// banks [first_bank, first_bank+num_banks). The same arguments give the same
+// sequence, so a read run revisits exactly what the write run wrote.
+class ADDR_PATTERN {
+public:
+    ADDR_PATTERN(PATTERN pattern, uint32_t first_bank, uint32_t num_banks,
+                 uint32_t word_bytes, unsigned seed)
+        : m_rng(seed) {
+        m_pattern = pattern;
+        m_first_bank = first_bank;
+        m_num_banks = num_banks;
+        m_word_bytes = word_bytes;
+        m_count = 0;
+    }
+
+    uint32_t next(void) {
+        uint64_t bank_size = 1 << BANK_ADDR_WIDTH;
+        uint64_t region = m_num_banks * bank_size;
+        uint64_t offset;
+        switch (m_pattern) {
+            case PAT_SEQUENTIAL:
+                offset = (m_count * m_word_bytes) % region;
+                break;
+            case PAT_STRIDED:
+                // move on by a word every time the stride wraps around
+                offset = ((m_count * STRIDE) % region
+                          + (m_count * STRIDE) / region * m_word_bytes) % region;
+                break;
+            case PAT_CROSS_BANK:
+                offset = (m_count % m_num_banks) * bank_size
+                         + (m_count / m_num_banks * m_word_bytes) % bank_size;
+                break;
+            default:
+                offset = m_rng() % (region / m_word_bytes) * m_word_bytes;
+                break;
+        }
+        m_count++;
+        return (m_first_bank << BANK_ADDR_WIDTH) + offset;
+    }
+
+private:
+    PATTERN         m_pattern;
+    uint32_t        m_first_bank;
+    uint32_t        m_num_banks;
+    uint32_t        m_word_bytes;
+    uint64_t        m_count;
+    std::mt19937    m_rng;
+};
+
+// Different data for every address, so a read is recognized on host_rd_data
+uint64_t bench_data(uint32_t addr) {
+    return (addr + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+class GLB_BENCH {
+public:
+    GLB_BENCH(GLB_TB *tb) {
+        m_tb = tb;
+        m_dut = tb->m_dut;
+        m_host_rd_cycle = 0;
+        m_io_rd.resize(NUM_IO);
+        m_cgra_done = false;
+    }
+
+    BENCH_RESULT host_wr(PATTERN pattern, uint32_t first_bank, uint32_t num_banks, unsigned seed) {
+        BENCH_RESULT result = {PATH_HOST_WR, pattern, 1, NUM_ACCESSES, 8*NUM_ACCESSES, 0, {}, 0};
+        ADDR_PATTERN addrs(pattern, first_bank, num_banks, 8, seed);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            uint32_t addr = addrs.next();
+            m_dut->host_wr_strb = 0xFF;
+            m_dut->host_wr_addr = addr;
+            m_dut->host_wr_data = bench_data(addr);
+            m_tb->tick();
+        }
+        m_dut->host_wr_strb = 0;
+        result.cycles = m_tb->tickcount() - start;
+        // let the golden model retire the writes in flight
+        m_tb->tick(10);
+        return result;
+    }
+
+    BENCH_RESULT host_rd(PATTERN pattern, uint32_t first_bank, uint32_t num_banks, unsigned seed) {
+        BENCH_RESULT result = {PATH_HOST_RD, pattern, 1, NUM_ACCESSES, 8*NUM_ACCESSES, 0, {}, 0};
+        ADDR_PATTERN addrs(pattern, first_bank, num_banks, 8, seed);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            host_rd_issue(addrs.next());
+            m_tb->tick();
+            host_rd_retire(result.latency);
+        }
+        m_dut->host_rd_en = 0;
+        drain(result.latency);
+        result.cycles = m_tb->tickcount() - start;
+        return result;
+    }
+
+    BENCH_RESULT sram_config_wr(PATTERN pattern, unsigned seed) {
+        BENCH_RESULT result = {PATH_SRAM_CONFIG_WR, pattern, 1, NUM_ACCESSES, 4*NUM_ACCESSES, 0, {}, 0};
+        ADDR_PATTERN addrs(pattern, 0, NUM_BANKS, 4, seed);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            uint32_t addr = addrs.next();
+            m_tb->config_sram_wr(glb->bank(addr), addr, (uint32_t)bench_data(addr));
+        }
+        result.cycles = m_tb->tickcount() - start;
+        return result;
+    }
+
+    BENCH_RESULT sram_config_rd(PATTERN pattern, unsigned seed) {
+        BENCH_RESULT result = {PATH_SRAM_CONFIG_RD, pattern, 1, NUM_ACCESSES, 4*NUM_ACCESSES, 0, {},
+                               SRAM_CONFIG_RD_LATENCY};
+        ADDR_PATTERN addrs(pattern, 0, NUM_BANKS, 4, seed);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            uint32_t addr = addrs.next();
+            m_tb->config_sram_rd(glb->bank(addr), addr);
+        }
+        result.cycles = m_tb->tickcount() - start;
+        return result;
+    }
+
+    // IO channels [0, channels) in SRAM mode, where the CGRA gives an
+    // address with every access. Channel k stays within its own banks.
+    BENCH_RESULT io_wr(PATTERN pattern, uint16_t channels, unsigned seed) {
+        BENCH_RESULT result = {PATH_IO_WR, pattern, channels, channels*NUM_ACCESSES, 2*channels*NUM_ACCESSES, 0, {}, 0};
+        std::vector<ADDR_PATTERN> addrs = io_patterns(pattern, channels, seed);
+        io_start(channels);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            for (uint16_t k=0; k<channels; k++) {
+                uint32_t addr = addrs[k].next();
+                m_tb->cgra_wr_sram(k, 1, addr, (uint16_t)bench_data(addr));
+            }
+            m_tb->tick();
+        }
+        for (uint16_t k=0; k<channels; k++)
+            m_dut->cgra_to_io_wr_en[k] = 0;
+        result.cycles = m_tb->tickcount() - start;
+        io_done();
+        return result;
+    }
+
+    BENCH_RESULT io_rd(PATTERN pattern, uint16_t channels, unsigned seed) {
+        BENCH_RESULT result = {PATH_IO_RD, pattern, channels, channels*NUM_ACCESSES, 2*channels*NUM_ACCESSES, 0, {}, 0};
+        std::vector<ADDR_PATTERN> addrs = io_patterns(pattern, channels, seed);
+        io_start(channels);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            for (uint16_t k=0; k<channels; k++)
+                io_rd_issue(k, addrs[k].next());
+            m_tb->tick();
+            io_rd_retire(result.latency);
+        }
+        for (uint16_t k=0; k<channels; k++)
+            m_dut->cgra_to_io_rd_en[k] = 0;
+        drain(result.latency);
+        result.cycles = m_tb->tickcount() - start;
+        io_done();
+        return result;
+    }
+
+    // IO reads as above with host reads to the banks above the IO channels
+    // at the same time. Needs channels <= NUM_IO/2.
+    BENCH_RESULT io_host_rd(PATTERN pattern, uint16_t channels, unsigned io_seed, unsigned host_seed) {
+        BENCH_RESULT result = {PATH_IO_HOST_RD, pattern, channels, (channels+1)*NUM_ACCESSES, (2*channels+8)*NUM_ACCESSES, 0, {}, 0};
+        std::vector<ADDR_PATTERN> addrs = io_patterns(pattern, channels, io_seed);
+        ADDR_PATTERN host_addrs(pattern, NUM_BANKS/2, NUM_BANKS/2, 8, host_seed);
+        io_start(channels);
+        unsigned long start = m_tb->tickcount();
+        for (unsigned long i=0; i<NUM_ACCESSES; i++) {
+            for (uint16_t k=0; k<channels; k++)
+                io_rd_issue(k, addrs[k].next());
+            host_rd_issue(host_addrs.next());
+            m_tb->tick();
+            io_rd_retire(result.latency);
+            host_rd_retire(result.latency);
+        }
+        for (uint16_t k=0; k<channels; k++)
+            m_dut->cgra_to_io_rd_en[k] = 0;
+        m_dut->host_rd_en = 0;
+        drain(result.latency);
+        result.cycles = m_tb->tickcount() - start;
+        io_done();
+        return result;
+    }
+
+    // Config channels [0, channels) stream NUM_ACCESSES words each from the
+    // first bank of their own banks, which has to hold data already. The
+    // address generators only stream sequentially. Latency is the time from
+    // config_start_pulse to the first word of a channel.
+    BENCH_RESULT cfg(uint16_t channels) {
+        BENCH_RESULT result = {PATH_CFG, PAT_SEQUENTIAL, channels, channels*NUM_ACCESSES, 8*channels*NUM_ACCESSES, 0, {}, 0};
+        uint16_t banks_per_cfg = NUM_BANKS / NUM_CFG;
+        CFG_CTRL *cfg_ctrl = new CFG_CTRL(NUM_CFG);
+        for (uint16_t k=0; k<channels; k++) {
+            cfg_ctrl->set_start_addr(k, (k * banks_per_cfg) << BANK_ADDR_WIDTH);
+            cfg_ctrl->set_num_words(k, NUM_ACCESSES);
+            cfg_ctrl->set_switch_sel(k, (1 << banks_per_cfg) - 1);
+        }
+        m_tb->glb_config_wr(cfg_ctrl);
+        delete cfg_ctrl;
+
+        std::vector<uint32_t> cfg_addr(channels);
+        std::vector<unsigned long> beats(channels, 0);
+        for (uint16_t k=0; k<channels; k++)
+            cfg_addr[k] = (k * banks_per_cfg) << BANK_ADDR_WIDTH;
+        unsigned long start = m_tb->tickcount();
+        m_dut->config_start_pulse = 1;
+        m_tb->tick();
+        m_dut->config_start_pulse = 0;
+        m_tb->run_until([this]() { return m_dut->config_done_pulse == 1; },
+                        NUM_ACCESSES + 1000,
+                        [&]() {
+                            for (uint16_t k=0; k<channels; k++) {
+                                if (m_dut->glb_to_cgra_cfg_wr[k] != 1)
+                                    continue;
+                                if (beats[k]++ == 0)
+                                    result.latency.push_back(m_tb->tickcount() - start);
+                                m_tb->my_assert_word(((uint64_t)m_dut->glb_to_cgra_cfg_addr[k] << 32) | m_dut->glb_to_cgra_cfg_data[k],
+                                                     glb->read_word(cfg_addr[k]), "glb_to_cgra_cfg", 32);
+                                cfg_addr[k] += 8;
+                            }
+                        }, "config_done_pulse");
+        result.cycles = m_tb->tickcount() - start;
+        for (uint16_t k=0; k<channels; k++)
+            m_tb->my_assert(beats[k], NUM_ACCESSES, "glb_to_cgra_cfg_wr beats");
+        return result;
+    }
+
+private:
+    struct PENDING {
+        unsigned long   cycle;
+        uint32_t        addr;
+        uint64_t        data;
+    };
+
+    GLB_TB                      *m_tb;
+    Vglobal_buffer_int          *m_dut;
+    std::deque<PENDING>         m_host_rd;
+    unsigned long               m_host_rd_cycle;
+    std::vector<std::deque<PENDING> > m_io_rd;
+    bool                        m_cgra_done;
+
+    std::vector<ADDR_PATTERN> io_patterns(PATTERN pattern, uint16_t channels, unsigned seed) {
+        uint16_t banks_per_io = NUM_BANKS / NUM_IO;
+        std::vector<ADDR_PATTERN> addrs;
+        for (uint16_t k=0; k<channels; k++)
+            addrs.push_back(ADDR_PATTERN(pattern, k * banks_per_io, banks_per_io, 2, seed + k));
+        return addrs;
+    }
+
+    void io_start(uint16_t channels) {
+        IO_CTRL *io_ctrl = new IO_CTRL(NUM_IO);
+        for (uint16_t k=0; k<channels; k++) {
+            io_ctrl->set_mode(k, SRAM);
+            io_ctrl->set_num_words(k, NUM_ACCESSES);
+            io_ctrl->set_switch_sel(k, (1 << (NUM_BANKS/NUM_IO)) - 1);
+        }
+        m_tb->glb_config_wr(io_ctrl);
+        delete io_ctrl;
+        m_cgra_done = false;
+        m_dut->cgra_start_pulse = 1;
+        m_tb->tick();
+        m_dut->cgra_start_pulse = 0;
+    }
+
+    // Every channel is done after NUM_ACCESSES accesses. The pulse may
+    // already have gone by while the last reads were drained.
+    void io_done(void) {
+        m_tb->run_until([this]() { return m_cgra_done || m_dut->cgra_done_pulse == 1; },
+                        100, nullptr, "cgra_done_pulse");
+    }
+
+    void host_rd_issue(uint32_t addr) {
+        m_dut->host_rd_en = 1;
+        m_dut->host_rd_addr = addr;
+        m_host_rd.push_back({m_tb->tickcount() + 1, addr, glb->read_word(addr)});
+    }
+
+    // The host port has no valid signal. Reads complete in order, one per
+    // cycle at most, when their data shows up on host_rd_data.
+    void host_rd_retire(std::vector<unsigned long> &latency) {
+        unsigned long now = m_tb->tickcount();
+        if (m_host_rd.empty() || m_host_rd_cycle == now)
+            return;
+        const PENDING &rd = m_host_rd.front();
+        if (rd.cycle < now && m_dut->host_rd_data == rd.data) {
+            latency.push_back(now - rd.cycle);
+            m_host_rd.pop_front();
+            m_host_rd_cycle = now;
+        }
+    }
+
+    void io_rd_issue(uint16_t k, uint32_t addr) {
+        m_tb->cgra_rd_sram(k, 1, addr);
+        m_io_rd[k].push_back({m_tb->tickcount() + 1, addr, glb->read_bytes(addr, 2)});
+    }
+
+    void io_rd_retire(std::vector<unsigned long> &latency) {
+        if (m_dut->cgra_done_pulse == 1)
+            m_cgra_done = true;
+        for (uint16_t k=0; k<NUM_IO; k++) {
+            if (m_dut->io_to_cgra_rd_data_valid[k] != 1)
+                continue;
+            m_tb->my_assert(m_io_rd[k].empty(), 0, "io_to_cgra_rd_data_valid");
+            const PENDING &rd = m_io_rd[k].front();
+            m_tb->my_assert(m_dut->io_to_cgra_rd_data[k], rd.data, "io_to_cgra_rd_data");
+            latency.push_back(m_tb->tickcount() - rd.cycle);
+            m_io_rd[k].pop_front();
+        }
+    }
+
+    bool reads_pending(void) {
+        for (uint16_t k=0; k<NUM_IO; k++) {
+            if (!m_io_rd[k].empty())
+                return true;
+        }
+        return !m_host_rd.empty();
+    }
+
+    void drain(std::vector<unsigned long> &latency) {
+        m_tb->run_while([this]() { return reads_pending(); }, 100,
+                        [&]() {
+                            io_rd_retire(latency);
+                            host_rd_retire(latency);
+                        }, "read data");
+    }
+};
+
+// Nearest rank percentile of sorted
+unsigned long percentile(const std::vector<unsigned long> &sorted, double p) {
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::max(rank, (size_t)1) - 1];
+}
+
+void print_result(BENCH_RESULT &result) {
+    printf("%-16s %-12s %8u %10lu %10lu %8.2f",
+           PATH_NAMES[result.path], PATTERN_NAMES[result.pattern],
+           result.channels, result.bytes, result.cycles,
+           (double)result.bytes / result.cycles);
+    if (result.fixed_latency) {
+        printf(" fixed latency %lu (RTL)\n", result.fixed_latency);
+        return;
+    }
+    if (result.latency.empty()) {
+        printf("\n");
+        return;
+    }
+    std::sort(result.latency.begin(), result.latency.end());
+    printf(" %6lu %6lu %6lu %6lu\n", percentile(result.latency, 50),
+           percentile(result.latency, 90), percentile(result.latency, 99),
+           result.latency.back());
+}
+
+bool write_json(const char *filename, const std::vector<BENCH_RESULT> &results) {
+    FILE *f = fopen(filename, "w");
+    if (f == NULL)
+        return false;
+    fprintf(f, "{\n");
+    fprintf(f, "  \"params\": {\"NUM_BANKS\": %u, \"NUM_IO\": %u, \"NUM_CFG\": %u, "
+               "\"BANK_ADDR_WIDTH\": %u, \"BANK_DATA_WIDTH\": %u, \"accesses\": %lu, \"stride\": %u},\n",
+            NUM_BANKS, NUM_IO, NUM_CFG, BANK_ADDR_WIDTH, BANK_DATA_WIDTH, NUM_ACCESSES, STRIDE);
+    fprintf(f, "  \"results\": [");
+    for (size_t i=0; i<results.size(); i++) {
+        const BENCH_RESULT &result = results[i];
+        fprintf(f, "%s\n    {\"path\": \"%s\", \"pattern\": \"%s\", \"channels\": %u, "
+                   "\"accesses\": %lu, \"bytes\": %lu, \"cycles\": %lu, \"bytes_per_cycle\": %.4f, ",
+                i ? "," : "", PATH_NAMES[result.path], PATTERN_NAMES[result.pattern],
+                result.channels, result.accesses, result.bytes, result.cycles,
+                (double)result.bytes / result.cycles);
+        if (result.fixed_latency) {
+            fprintf(f, "\"latency\": null, \"fixed_latency\": %lu}", result.fixed_latency);
+        }
+        else if (result.latency.empty()) {
+            fprintf(f, "\"latency\": null}");
+        }
+        else {
+            fprintf(f, "\"latency\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}}",
+                    percentile(result.latency, 50), percentile(result.latency, 90),
+                    percentile(result.latency, 99), result.latency.back());
+        }
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    TB_ARGS tb_args;
+    // no waveform unless asked for, it would dominate the run time
+    tb_args.trace = false;
+    string json_file, bank_stats;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "NUM_BANKS") {
+            NUM_BANKS = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_DATA_WIDTH") {
+            BANK_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CGRA_DATA_WIDTH") {
+            CGRA_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            // only sizes the RTL
+        }
+        else if (argv_tmp == "CFG_ADDR_WIDTH") {
+            CFG_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CFG_DATA_WIDTH") {
+            CFG_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--accesses") {
+            NUM_ACCESSES = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--json") {
+            json_file = argv[i+1];
+        }
+        else if (argv_tmp == "--bank-stats") {
+            bank_stats = argv[i+1];
+        }
+        else if (!tb_args.parse(argv_tmp, argv[i+1])) {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("Seed: %u\n", tb_args.seed);
+    srand (tb_args.seed);
+
+    glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH);
+
+    GLB_TB *glb_tb = new GLB_TB();
+    glb_tb->trace_options(tb_args);
+    glb_tb->log_options(tb_args);
+    glb_tb->perf_options(tb_args);
+    if (tb_args.trace)
+        glb_tb->opentrace("trace_bench_glb_int.vcd");
+    if (tb_args.record)
+        glb_tb->openrecorder("flight_bench_glb_int.vcd", tb_args.record, tb_args.record_signals);
+    glb_tb->reset();
+    if (!bank_stats.empty())
+        glb_tb->enable_bank_stats();
+
+    GLB_BENCH bench(glb_tb);
+    std::vector<BENCH_RESULT> results;
+    printf("%-16s %-12s %8s %10s %10s %8s %6s %6s %6s %6s\n", "path", "pattern",
+           "channels", "bytes", "cycles", "B/cycle", "p50", "p90", "p99", "max");
+    auto add = [&](BENCH_RESULT result) {
+        print_result(result);
+        results.push_back(result);
+    };
+
+    // Every read run follows the write run with the same pattern and seed,
+    // so it only reads data written through the DUT
+    for (int p=PAT_SEQUENTIAL; p<=PAT_RANDOM; p++) {
+        PATTERN pattern = (PATTERN)p;
+        unsigned seed = tb_args.seed + 16*p;
+        add(bench.host_wr(pattern, 0, NUM_BANKS, seed));
+        add(bench.host_rd(pattern, 0, NUM_BANKS, seed));
+        add(bench.sram_config_wr(pattern, seed + 1));
+        add(bench.sram_config_rd(pattern, seed + 1));
+        for (uint16_t channels=1; channels<=NUM_IO; channels*=2) {
+            add(bench.io_wr(pattern, channels, seed + 2));
+            add(bench.io_rd(pattern, channels, seed + 2));
+        }
+        bench.host_wr(pattern, NUM_BANKS/2, NUM_BANKS/2, seed + 3);
+        for (uint16_t channels=1; channels<=NUM_IO/2; channels*=2)
+            add(bench.io_host_rd(pattern, channels, seed + 2, seed + 3));
+    }
+
+    // the config streams read what the host wrote to the first bank of
+    // every channel
+    for (uint16_t k=0; k<NUM_CFG; k++)
+        bench.host_wr(PAT_SEQUENTIAL, k * (NUM_BANKS/NUM_CFG), 1, tb_args.seed);
+    for (uint16_t channels=1; channels<=NUM_CFG; channels*=2)
+        add(bench.cfg(channels));
+
+    if (!json_file.empty() && !write_json(json_file.c_str(), results)) {
+        std::cerr << "Cannot write " << json_file << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    printf("\n");
+    glb_tb->perf_report();
+    if (!bank_stats.empty()) {
+        glb_tb->bank_stats()->print_summary();
+        if (!glb_tb->bank_stats()->write(bank_stats)) {
+            std::cerr << "Cannot write " << bank_stats << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    delete glb_tb;
+    delete glb;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// One configuration write of a CGRA bitstream
+struct BITSTREAM_ENTRY {
+    uint32_t addr;
+    uint32_t data;
+};
+
+// Bitstream as written by garnet.py --output, one "AAAAAAAA DDDDDDDD" hex
+// address/data pair per line. Returns false if the file cannot be read or
+// a line does not parse.
+inline bool load_bitstream(const char *filename, std::vector<BITSTREAM_ENTRY> &bitstream) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL)
+        return false;
+    bitstream.clear();
+    char line[256];
+    bool ok = true;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int addr, data;
+        char extra;
+        int n = sscanf(line, "%x %x %c", &addr, &data, &extra);
+        if (n == 2) {
+            bitstream.push_back({addr, data});
+        }
+        else if (n != EOF) {
+            ok = false;
+            break;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Bank word streamed to the CGRA for entry: lane 0 is the data, lane 1 the
+// address
+inline uint64_t bitstream_word(const BITSTREAM_ENTRY &entry) {
+    return ((uint64_t)entry.addr << 32) | entry.data;
+}
+
+#endif
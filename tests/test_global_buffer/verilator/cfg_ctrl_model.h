@@ -0,0 +1,418 @@
+#ifndef CFG_CTRL_MODEL_H
+#define CFG_CTRL_MODEL_H
+
+// Cycle-accurate C++ models of cfg_address_generator and cfg_controller
+// (global_buffer/genesis), including the pass-through of the global
+// controller's (JTAG) configuration accesses. They take no Verilator model,
+// to plan how a bitstream is split over the channels standalone or to
+// predict every output of the DUT in CFG_CTRL_TB.
+//
+// Ports are public members like on IO_CTRL_MODEL (io_ctrl_model.h): set the
+// inputs, eval() to settle the outputs, then clock() for the rising edge.
+// Registers without a reset in the RTL start out as 0.
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+class CFG_ADDR_GEN_MODEL {
+public:
+    // inputs
+    uint8_t     reset;
+    uint8_t     config_start_pulse;
+    uint32_t    start_addr;
+    uint32_t    num_words;
+    uint64_t    bank_to_cfg_rd_data;
+    uint8_t     bank_to_cfg_rd_data_valid;
+
+    // outputs
+    uint8_t     config_done_pulse;
+    uint8_t     cfg_to_bank_rd_en;
+    uint32_t    cfg_to_bank_addr;
+    uint8_t     cfg_to_cgra_config_wr;
+    uint32_t    cfg_to_cgra_config_addr;
+    uint32_t    cfg_to_cgra_config_data;
+
+    CFG_ADDR_GEN_MODEL(unsigned bank_data_width=64, unsigned glb_addr_width=32,
+                       unsigned cfg_addr_width=32, unsigned cfg_data_width=32) {
+        if (bank_data_width > 64 || glb_addr_width > 32 || cfg_addr_width > 32
+                || cfg_data_width > 32 || cfg_addr_width + cfg_data_width > bank_data_width) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "CFG_ADDR_GEN_MODEL does not support BANK_DATA_WIDTH " << bank_data_width
+                      << ", GLB_ADDR_WIDTH " << glb_addr_width
+                      << ", CFG_ADDR_WIDTH " << cfg_addr_width
+                      << ", CFG_DATA_WIDTH " << cfg_data_width << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_bank_data_byte = bank_data_width / 8;
+        m_glb_addr_mask = (uint32_t)mask(glb_addr_width);
+        m_bank_addr_mask = m_glb_addr_mask & ~(m_bank_data_byte - 1);
+        m_cfg_data_width = cfg_data_width;
+        m_cfg_addr_mask = mask(cfg_addr_width);
+        m_cfg_data_mask = mask(cfg_data_width);
+
+        reset = 0;
+        config_start_pulse = 0;
+        start_addr = num_words = 0;
+        bank_to_cfg_rd_data = 0;
+        bank_to_cfg_rd_data_valid = 0;
+        m_state = STATE();
+        eval();
+    }
+
+    static uint64_t mask(unsigned width) {
+        return width >= 64 ? ~0ULL : (1ULL << width) - 1;
+    }
+
+    // Settle the outputs. The reset is asynchronous like in the RTL.
+    void eval(void) {
+        if (reset)
+            async_reset(m_state);
+        const STATE &s = m_state;
+        uint64_t rd_data = s.rd_en_d2 ? bank_to_cfg_rd_data : 0;
+        config_done_pulse = s.done_pulse;
+        cfg_to_bank_rd_en = s.rd_en;
+        cfg_to_bank_addr = s.addr & m_bank_addr_mask;
+        cfg_to_cgra_config_wr = s.rd_en_d2 ? bank_to_cfg_rd_data_valid : 0;
+        cfg_to_cgra_config_addr = (rd_data >> m_cfg_data_width) & m_cfg_addr_mask;
+        cfg_to_cgra_config_data = rd_data & m_cfg_data_mask;
+    }
+
+    // Rising edge of clk
+    void clock(void) {
+        const STATE &s = m_state;
+        STATE n = s;
+        n.rd_en_d1 = cfg_to_bank_rd_en;
+        n.rd_en_d2 = s.rd_en_d1;
+        n.rd_en = 0;
+        n.done_pulse = 0;
+        if (reset) {
+            async_reset(n);
+            m_state = n;
+            return;
+        }
+        switch (s.state) {
+        case START:
+            if (config_start_pulse) {
+                n.state = num_words > 0 ? RUN : DONE;
+                n.num_words = num_words;
+                n.addr = start_addr;
+                n.rd_en = num_words > 0;
+            }
+            else {
+                n.num_words = 0;
+            }
+            break;
+        case RUN:
+            if (s.num_words == 1) {
+                n.state = DONE;
+                n.num_words = 0;
+            }
+            else {
+                n.num_words = s.num_words - 1;
+                n.addr = (s.addr + m_bank_data_byte) & m_glb_addr_mask;
+                n.rd_en = 1;
+            }
+            break;
+        case DONE:
+            n.state = START;
+            n.num_words = 0;
+            n.done_pulse = 1;
+            break;
+        default:
+            n.state = START;
+            n.num_words = 0;
+            break;
+        }
+        m_state = n;
+    }
+
+private:
+    enum FSM_STATE {
+        START   = 0,    // IDLE
+        RUN     = 1,    // READ
+        DONE    = 2
+    };
+
+    struct STATE {
+        uint8_t     rd_en_d1 = 0;
+        uint8_t     rd_en_d2 = 0;
+        uint8_t     state = START;
+        uint32_t    num_words = 0;
+        uint32_t    addr = 0;
+        uint8_t     rd_en = 0;
+        uint8_t     done_pulse = 0;
+    };
+
+    uint32_t    m_bank_data_byte;
+    uint32_t    m_glb_addr_mask;
+    uint32_t    m_bank_addr_mask;
+    unsigned    m_cfg_data_width;
+    uint64_t    m_cfg_addr_mask;
+    uint64_t    m_cfg_data_mask;
+    STATE       m_state;
+
+    static void async_reset(STATE &s) {
+        s.state = START;
+        s.num_words = 0;
+        s.addr = 0;
+        s.rd_en = 0;
+        s.done_pulse = 0;
+    }
+};
+
+// cfg_controller: the config registers, one CFG_ADDR_GEN_MODEL per channel,
+// the switch_sel chains to the banks, the read network back and the
+// outputs to the CGRA, which fan out a global controller access to every
+// channel instead while there is one.
+class CFG_CTRL_MODEL {
+public:
+    // inputs
+    uint8_t                 reset;
+    uint8_t                 config_start_pulse;
+    std::vector<uint64_t>   bank_to_cfg_rd_data;
+    uint8_t                 glc_to_cgra_cfg_wr;
+    uint8_t                 glc_to_cgra_cfg_rd;
+    uint32_t                glc_to_cgra_cfg_addr;
+    uint32_t                glc_to_cgra_cfg_data;
+    uint8_t                 config_en;
+    uint8_t                 config_wr;
+    uint8_t                 config_rd;
+    uint32_t                config_addr;
+    uint32_t                config_wr_data;
+
+    // outputs
+    uint8_t                 config_done_pulse;
+    std::vector<uint8_t>    cfg_to_bank_rd_en;
+    std::vector<uint32_t>   cfg_to_bank_rd_addr;
+    std::vector<uint8_t>    glb_to_cgra_cfg_wr;
+    std::vector<uint8_t>    glb_to_cgra_cfg_rd;
+    std::vector<uint32_t>   glb_to_cgra_cfg_addr;
+    std::vector<uint32_t>   glb_to_cgra_cfg_data;
+    uint32_t                config_rd_data;
+
+    CFG_CTRL_MODEL(unsigned num_banks=32, unsigned num_cfg=8, unsigned bank_addr_width=17,
+                   unsigned bank_data_width=64, unsigned glb_addr_width=32,
+                   unsigned cfg_addr_width=32, unsigned cfg_data_width=32,
+                   unsigned config_feature_width=4, unsigned config_reg_width=4)
+        : m_gens(num_cfg, CFG_ADDR_GEN_MODEL(bank_data_width, glb_addr_width,
+                                             cfg_addr_width, cfg_data_width)) {
+        m_num_banks = num_banks;
+        m_num_cfg = num_cfg;
+        m_banks_per_cfg = (num_banks + num_cfg - 1) / num_cfg;
+        if (m_banks_per_cfg * num_cfg != num_banks || num_cfg > 32) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "CFG_CTRL_MODEL needs the banks evenly split over at most 32 channels" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_bank_addr_width = bank_addr_width;
+        m_glb_addr_mask = (uint32_t)CFG_ADDR_GEN_MODEL::mask(glb_addr_width);
+        m_config_reg_width = config_reg_width;
+        m_config_feature_mask = (uint32_t)CFG_ADDR_GEN_MODEL::mask(config_feature_width);
+
+        reset = 0;
+        config_start_pulse = 0;
+        bank_to_cfg_rd_data.assign(num_banks, 0);
+        glc_to_cgra_cfg_wr = glc_to_cgra_cfg_rd = 0;
+        glc_to_cgra_cfg_addr = glc_to_cgra_cfg_data = 0;
+        config_en = config_wr = config_rd = 0;
+        config_addr = config_wr_data = 0;
+
+        cfg_to_bank_rd_en.assign(num_banks, 0);
+        cfg_to_bank_rd_addr.assign(num_banks, 0);
+        glb_to_cgra_cfg_wr.assign(num_cfg, 0);
+        glb_to_cgra_cfg_rd.assign(num_cfg, 0);
+        glb_to_cgra_cfg_addr.assign(num_cfg, 0);
+        glb_to_cgra_cfg_data.assign(num_cfg, 0);
+
+        m_cfg.assign(num_cfg, CONFIG());
+        m_ports.assign(num_cfg, CGRA_PORT());
+        m_done_reg = 0;
+        m_done_all = m_done_all_d1 = 0;
+        m_rd_en_d1.assign(num_banks, 0);
+        m_rd_en_d2.assign(num_banks, 0);
+        m_rd_data_d1.assign(num_banks, 0);
+        m_chain_rd_data.assign(num_banks, 0);
+        m_chain_rd_data_valid.assign(num_banks, 0);
+        eval();
+    }
+
+    unsigned num_banks(void) const {
+        return m_num_banks;
+    }
+
+    unsigned num_cfg(void) const {
+        return m_num_cfg;
+    }
+
+    unsigned banks_per_cfg(void) const {
+        return m_banks_per_cfg;
+    }
+
+    // Settle the outputs
+    void eval(void) {
+        if (reset) {
+            m_cfg.assign(m_num_cfg, CONFIG());
+            m_done_reg = 0;
+        }
+
+        // read network, from the last bank down: a bank returning data
+        // covers the ones below it
+        uint64_t rd_data = 0;
+        uint8_t rd_data_valid = 0;
+        for (unsigned k=m_num_banks; k-- > 0;) {
+            if (m_rd_en_d2[k]) {
+                rd_data = m_rd_data_d1[k];
+                rd_data_valid = 1;
+            }
+            m_chain_rd_data[k] = rd_data;
+            m_chain_rd_data_valid[k] = rd_data_valid;
+        }
+
+        bool glc = glc_to_cgra_cfg_rd || glc_to_cgra_cfg_wr;
+        for (unsigned j=0; j<m_num_cfg; j++) {
+            CFG_ADDR_GEN_MODEL &gen = m_gens[j];
+            const CONFIG &cfg = m_cfg[j];
+            gen.reset = reset;
+            gen.config_start_pulse = config_start_pulse;
+            gen.start_addr = cfg.start_addr;
+            gen.num_words = cfg.num_words;
+            // a channel reads through the first bank it is switched to
+            gen.bank_to_cfg_rd_data = 0;
+            gen.bank_to_cfg_rd_data_valid = 0;
+            for (unsigned k=0; k<m_banks_per_cfg; k++) {
+                if ((cfg.switch_sel >> k) & 1) {
+                    gen.bank_to_cfg_rd_data = m_chain_rd_data[j*m_banks_per_cfg + k];
+                    gen.bank_to_cfg_rd_data_valid = m_chain_rd_data_valid[j*m_banks_per_cfg + k];
+                    break;
+                }
+            }
+            gen.eval();
+
+            // a channel that is switched off repeats the one before it
+            CGRA_PORT &port = m_ports[j];
+            if (j == 0 || cfg.switch_sel != 0) {
+                port.wr = gen.cfg_to_cgra_config_wr;
+                port.addr = gen.cfg_to_cgra_config_addr;
+                port.data = gen.cfg_to_cgra_config_data;
+            }
+            else {
+                port = m_ports[j-1];
+            }
+            glb_to_cgra_cfg_rd[j] = glc_to_cgra_cfg_rd;
+            glb_to_cgra_cfg_wr[j] = port.wr | glc_to_cgra_cfg_wr;
+            glb_to_cgra_cfg_addr[j] = glc ? glc_to_cgra_cfg_addr : port.addr;
+            glb_to_cgra_cfg_data[j] = glc ? glc_to_cgra_cfg_data : port.data;
+        }
+
+        // address network: a bank takes the channel it is switched to,
+        // otherwise whatever the bank below it has
+        uint32_t addr = 0;
+        uint8_t rd_en = 0;
+        for (unsigned k=0; k<m_num_banks; k++) {
+            unsigned j = k / m_banks_per_cfg;
+            if ((m_cfg[j].switch_sel >> (k % m_banks_per_cfg)) & 1) {
+                addr = m_gens[j].cfg_to_bank_addr;
+                rd_en = m_gens[j].cfg_to_bank_rd_en;
+            }
+            cfg_to_bank_rd_en[k] = rd_en && (addr >> m_bank_addr_width) == k;
+            cfg_to_bank_rd_addr[k] = addr & (uint32_t)CFG_ADDR_GEN_MODEL::mask(m_bank_addr_width);
+        }
+
+        // done once every channel is, switched off or not
+        m_done_all = m_done_reg == (uint32_t)CFG_ADDR_GEN_MODEL::mask(m_num_cfg);
+        config_done_pulse = m_done_all && !m_done_all_d1;
+
+        config_rd_data = 0;
+        unsigned feature = (config_addr >> m_config_reg_width) & m_config_feature_mask;
+        if (config_en && config_rd && feature < m_num_cfg) {
+            const CONFIG &cfg = m_cfg[feature];
+            switch (config_addr & CFG_ADDR_GEN_MODEL::mask(m_config_reg_width)) {
+            case 0: config_rd_data = cfg.start_addr; break;
+            case 1: config_rd_data = cfg.num_words; break;
+            case 2: config_rd_data = cfg.switch_sel; break;
+            }
+        }
+    }
+
+    // Rising edge of clk
+    void clock(void) {
+        if (config_start_pulse) {
+            m_done_reg = 0;
+        }
+        else {
+            for (unsigned j=0; j<m_num_cfg; j++) {
+                if (m_gens[j].config_done_pulse)
+                    m_done_reg |= 1u << j;
+            }
+        }
+        m_done_all_d1 = m_done_all;
+
+        for (unsigned k=0; k<m_num_banks; k++) {
+            m_rd_en_d2[k] = m_rd_en_d1[k];
+            m_rd_en_d1[k] = cfg_to_bank_rd_en[k];
+            m_rd_data_d1[k] = bank_to_cfg_rd_data[k];
+        }
+        for (unsigned j=0; j<m_num_cfg; j++)
+            m_gens[j].clock();
+
+        unsigned feature = (config_addr >> m_config_reg_width) & m_config_feature_mask;
+        if (config_en && config_wr && feature < m_num_cfg) {
+            CONFIG &cfg = m_cfg[feature];
+            switch (config_addr & CFG_ADDR_GEN_MODEL::mask(m_config_reg_width)) {
+            case 0: cfg.start_addr = config_wr_data & m_glb_addr_mask; break;
+            case 1: cfg.num_words = config_wr_data & m_glb_addr_mask; break;
+            case 2: cfg.switch_sel = config_wr_data & (uint32_t)CFG_ADDR_GEN_MODEL::mask(m_banks_per_cfg); break;
+            }
+        }
+        if (reset) {
+            m_cfg.assign(m_num_cfg, CONFIG());
+            m_done_reg = 0;
+        }
+    }
+
+    // Program channel i directly, as the config writes would
+    void configure(unsigned i, uint32_t start_addr, uint32_t num_words, uint32_t switch_sel) {
+        CONFIG &cfg = m_cfg[i];
+        cfg.start_addr = start_addr & m_glb_addr_mask;
+        cfg.num_words = num_words & m_glb_addr_mask;
+        cfg.switch_sel = switch_sel & (uint32_t)CFG_ADDR_GEN_MODEL::mask(m_banks_per_cfg);
+    }
+
+private:
+    struct CONFIG {
+        uint32_t    start_addr = 0;
+        uint32_t    num_words = 0;
+        uint32_t    switch_sel = 0;
+    };
+
+    // what a channel drives towards the CGRA before the glc mux
+    struct CGRA_PORT {
+        uint8_t     wr = 0;
+        uint32_t    addr = 0;
+        uint32_t    data = 0;
+    };
+
+    unsigned                        m_num_banks;
+    unsigned                        m_num_cfg;
+    unsigned                        m_banks_per_cfg;
+    unsigned                        m_bank_addr_width;
+    uint32_t                        m_glb_addr_mask;
+    unsigned                        m_config_reg_width;
+    uint32_t                        m_config_feature_mask;
+
+    std::vector<CFG_ADDR_GEN_MODEL> m_gens;
+    std::vector<CONFIG>             m_cfg;
+    std::vector<CGRA_PORT>          m_ports;
+    uint32_t                        m_done_reg;
+    uint8_t                         m_done_all;
+    uint8_t                         m_done_all_d1;
+    std::vector<uint8_t>            m_rd_en_d1;
+    std::vector<uint8_t>            m_rd_en_d2;
+    std::vector<uint64_t>           m_rd_data_d1;
+    std::vector<uint64_t>           m_chain_rd_data;
+    std::vector<uint8_t>            m_chain_rd_data_valid;
+};
+
+#endif
@@ -0,0 +1,478 @@
+#ifndef CFG_CTRL_TB_H
+#define CFG_CTRL_TB_H
+
+// Testbench of cfg_controller, shared by the test driver and the speed
+// benchmark: RTL parameters, the CFG controller model and CFG_CTRL_TB.
+
+#include "Vcfg_controller.h"
+#include "verilated.h"
+#include "testbench.h"
+#include "cfg_ctrl_model.h"
+#include "shadow_memory.h"
+#include "bitstream.h"
+#include "time.h"
+#include <vector>
+#include <random>
+#include <string.h>
+
+// Address is byte addressable
+uint16_t NUM_BANKS = 32;
+uint16_t NUM_CFG = 8;
+uint16_t BANK_ADDR_WIDTH = 17;
+uint16_t BANK_DATA_WIDTH = 64;
+uint16_t CGRA_DATA_WIDTH = 16;
+uint16_t GLB_ADDR_WIDTH = 32;
+uint16_t CONFIG_FEATURE_WIDTH = 4;
+uint16_t CONFIG_REG_WIDTH = 4;
+
+// Cycles from a config read request to valid data, registers are muxed
+// combinationally
+const unsigned CONFIG_RD_LATENCY = 0;
+
+using namespace std;
+
+GLB_SHADOW *glb;
+
+typedef enum REG_ID
+{
+    ID_START_ADDR      = 0,
+    ID_NUM_WORDS       = 1,
+    ID_SWITCH_SEL      = 2
+} REG_ID;
+
+// Events of the binary event log (--event-log)
+typedef enum EVENT
+{
+    EV_CFG_WR     = 0,
+    EV_BANK_RD    = 1
+} EVENT;
+
+const char *EVENT_NAMES[] = {"glb_to_cgra_cfg_wr", "bank_to_cfg_rd"};
+
+struct Addr_gen
+{
+    uint16_t id;
+    uint32_t start_addr;
+    uint32_t int_addr;
+    uint32_t num_words;
+    uint32_t int_cnt;
+    uint32_t switch_sel;
+};
+
+class CFG_CTRL {
+public:
+    CFG_CTRL(uint16_t num_cfg) {
+        addr_gens = new Addr_gen[num_cfg];
+        this->num_cfg = num_cfg;
+        for (uint16_t i=0; i<num_cfg; i++) {
+            addr_gens[i].id = i;
+            addr_gens[i].start_addr = 0;
+            addr_gens[i].int_addr = 0;
+            addr_gens[i].int_cnt = 0;
+            addr_gens[i].num_words = 0;
+            addr_gens[i].switch_sel = 0;
+        }
+    }
+    ~CFG_CTRL(void) {
+        delete[] addr_gens; 
+    }
+
+    uint16_t get_num_cfg() {
+        return this->num_cfg;
+    }
+
+    uint32_t get_start_addr(uint16_t num_cfg) {
+        return addr_gens[num_cfg].start_addr;
+    }
+
+    uint32_t get_int_addr(uint16_t num_cfg) {
+        return addr_gens[num_cfg].int_addr;
+    }
+
+    uint32_t get_num_words(uint16_t num_cfg) {
+        return addr_gens[num_cfg].num_words;
+    }
+
+    uint32_t get_int_cnt(uint16_t num_cfg) {
+        return addr_gens[num_cfg].int_cnt;
+    }
+
+    uint32_t get_switch_sel(uint16_t num_cfg) {
+        return addr_gens[num_cfg].switch_sel;
+    }
+
+    Addr_gen& get_addr_gen(uint16_t num_cfg) {
+        return addr_gens[num_cfg];
+    }
+
+    void set_start_addr(uint16_t num_cfg, uint32_t start_addr) {
+        if (start_addr % 8 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg].start_addr = start_addr;
+    }
+
+    void set_int_addr(uint16_t num_cfg, uint32_t int_addr) {
+        if (int_addr % 8 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg].int_addr = int_addr;
+    }
+
+    void set_num_words(uint16_t num_cfg, uint32_t num_words) {
+        addr_gens[num_cfg].num_words = num_words;
+    }
+
+    void set_int_cnt(uint16_t num_cfg, uint32_t int_cnt) {
+        addr_gens[num_cfg].int_cnt = int_cnt;
+    }
+
+    void set_switch_sel(uint16_t num_cfg, uint32_t switch_sel) {
+        if (switch_sel >= (1<<(NUM_BANKS/NUM_CFG)) ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "CFG controller " << num_cfg << "select switch cannot be configed to " << std::hex << "0x" << switch_sel <<  std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg].switch_sel = switch_sel;
+    }
+
+private:
+    Addr_gen *addr_gens;
+    uint16_t num_cfg;
+};
+
+struct BANK_RD {
+    uint16_t bank;
+    uint32_t addr;
+};
+
+class CFG_CTRL_TB : public TESTBENCH<Vcfg_controller> {
+public:
+    // bank reads in flight, by cycles until the data is returned
+    LATENCY_QUEUE<BANK_RD> bank_rd_queue;
+    // bitstream words checked on glb_to_cgra_cfg
+    unsigned long cfg_beats;
+
+    CFG_CTRL_TB(unsigned bank_rd_latency=1)
+        : bank_rd_queue(bank_rd_latency) {
+        cfg_beats = 0;
+        for (uint16_t i=0; i<sizeof(EVENT_NAMES)/sizeof(EVENT_NAMES[0]); i++)
+            tb_log.define_event(i, EVENT_NAMES[i]);
+        reset();
+    }
+
+    ~CFG_CTRL_TB(void) {
+        delete m_model;
+    }
+
+    // Check every output of the DUT against CFG_CTRL_MODEL from now on. The
+    // model starts out as after a reset, so enable it before reset().
+    void enable_model(void) {
+        delete m_model;
+        m_model = new CFG_CTRL_MODEL(NUM_BANKS, NUM_CFG, BANK_ADDR_WIDTH, BANK_DATA_WIDTH,
+                                     GLB_ADDR_WIDTH, 32, 32,
+                                     CONFIG_FEATURE_WIDTH, CONFIG_REG_WIDTH);
+    }
+
+    void update() {
+        glb_update();
+        if (m_model) model_check();
+    }
+
+    void probe_ports(PORT_PROBE *recorder) {
+        recorder->probe("reset", &m_dut->reset, 1);
+        recorder->probe("config_start_pulse", &m_dut->config_start_pulse, 1);
+        recorder->probe("config_done_pulse", &m_dut->config_done_pulse, 1);
+        recorder->probe("cfg_to_bank_rd_en", m_dut->cfg_to_bank_rd_en, NUM_BANKS, 1);
+        recorder->probe("cfg_to_bank_rd_addr", m_dut->cfg_to_bank_rd_addr, NUM_BANKS, BANK_ADDR_WIDTH);
+        recorder->probe("bank_to_cfg_rd_data", m_dut->bank_to_cfg_rd_data, NUM_BANKS, BANK_DATA_WIDTH);
+        recorder->probe("glc_to_cgra_cfg_wr", &m_dut->glc_to_cgra_cfg_wr, 1);
+        recorder->probe("glc_to_cgra_cfg_rd", &m_dut->glc_to_cgra_cfg_rd, 1);
+        recorder->probe("glc_to_cgra_cfg_addr", &m_dut->glc_to_cgra_cfg_addr, 32);
+        recorder->probe("glc_to_cgra_cfg_data", &m_dut->glc_to_cgra_cfg_data, 32);
+        recorder->probe("glb_to_cgra_cfg_wr", m_dut->glb_to_cgra_cfg_wr, NUM_CFG, 1);
+        recorder->probe("glb_to_cgra_cfg_rd", m_dut->glb_to_cgra_cfg_rd, NUM_CFG, 1);
+        recorder->probe("glb_to_cgra_cfg_addr", m_dut->glb_to_cgra_cfg_addr, NUM_CFG, 32);
+        recorder->probe("glb_to_cgra_cfg_data", m_dut->glb_to_cgra_cfg_data, NUM_CFG, 32);
+        recorder->probe("config_en", &m_dut->config_en, 1);
+        recorder->probe("config_wr", &m_dut->config_wr, 1);
+        recorder->probe("config_rd", &m_dut->config_rd, 1);
+        recorder->probe("config_addr", &m_dut->config_addr, CONFIG_FEATURE_WIDTH+CONFIG_REG_WIDTH);
+        recorder->probe("config_wr_data", &m_dut->config_wr_data, 32);
+        recorder->probe("config_rd_data", &m_dut->config_rd_data, 32);
+    }
+
+    void config_wr(Addr_gen &addr_gen) {
+        uint16_t num_id = addr_gen.id;
+        config_wr(num_id, ID_START_ADDR, addr_gen.start_addr);
+        config_wr(num_id, ID_NUM_WORDS, addr_gen.num_words);
+        config_wr(num_id, ID_SWITCH_SEL, addr_gen.switch_sel);
+    }
+
+    void config_wr(uint16_t num_ctrl, REG_ID reg_id, uint32_t data) {
+        TB_LOG(LOG_INFO, "Configuration for %d\n", num_ctrl);
+        if (num_ctrl > NUM_CFG ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Wrong number of io controller" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+        uint32_t feature_id = num_ctrl;
+        uint32_t config_addr = (feature_id << CONFIG_REG_WIDTH) + reg_id;
+        uint32_t config_data = data;
+        m_dut->config_en = 1;
+        m_dut->config_wr = 1;
+        m_dut->config_addr = config_addr;
+        m_dut->config_wr_data = config_data;
+        tick();
+        m_dut->config_en = 0;
+        m_dut->config_wr = 0;
+        m_config_cycles++;
+    }
+
+    void config_rd(Addr_gen &addr_gen) {
+        uint16_t num_id = addr_gen.id;
+        config_rd(num_id, ID_START_ADDR, addr_gen.start_addr);
+        config_rd(num_id, ID_NUM_WORDS, addr_gen.num_words);
+        config_rd(num_id, ID_SWITCH_SEL, addr_gen.switch_sel);
+    }
+
+    // Register reads are combinational, so this takes a single cycle like
+    // a write and the next access follows right after
+    void config_rd(uint16_t num_ctrl, REG_ID reg_id, uint32_t data_expected) {
+        uint32_t feature_id = num_ctrl;
+        uint32_t config_addr = (feature_id << CONFIG_REG_WIDTH) + reg_id;
+        m_dut->config_en = 1;
+        m_dut->config_rd = 1;
+        m_dut->config_addr = config_addr;
+        m_config_cycles += read_at_latency(CONFIG_RD_LATENCY, [&]() {
+            my_assert(m_dut->config_rd_data, data_expected, "config_rd_data");
+        });
+        m_dut->config_en = 0;
+        m_dut->config_rd = 0;
+    }
+
+    void cfg_ctrl_setup(CFG_CTRL* cfg_ctrl) {
+        for(uint16_t i=0; i < cfg_ctrl->get_num_cfg(); i++) {
+            cfg_ctrl->set_int_addr(i, cfg_ctrl->get_start_addr(i));
+            cfg_ctrl->set_int_cnt(i, cfg_ctrl->get_num_words(i));
+        }
+    }
+    
+    // Returns the cycles from config_start_pulse to config_done_pulse
+    unsigned long test(CFG_CTRL* cfg_ctrl) {
+        // glb setting
+        for(uint16_t i=0; i<cfg_ctrl->get_num_cfg(); i++) {
+            config_wr(cfg_ctrl->get_addr_gen(i)); 
+        }
+
+        // why hurry?
+        tick(100);
+
+        unsigned long start = m_tickcount;
+        // toggle config_start_pulse
+        m_dut->config_start_pulse = 1;
+        tick();
+        m_dut->config_start_pulse = 0;
+
+        // internal counter and address set to num_words and start_address
+        cfg_ctrl_setup(cfg_ctrl);
+
+        // latency of read
+        tick();
+
+        TB_LOG(LOG_INFO, "CFG Controller starts\n");
+
+        // every channel streams one word per cycle
+        uint32_t max_num_words = 0;
+        for(uint16_t i=0; i < cfg_ctrl->get_num_cfg(); i++) {
+            max_num_words = std::max(cfg_ctrl->get_num_words(i), max_num_words);
+        }
+        run_until([this]() { return m_dut->config_done_pulse == 1; },
+                  max_num_words + 1000,
+                  [&]() { instream(cfg_ctrl); }, "config_done_pulse");
+        unsigned long cycles = m_tickcount - start;
+
+        TB_LOG(LOG_INFO, "End feeding bitstream\n");
+        
+        // why hurry?
+        for (uint32_t t=0; t<100; t++) {
+            tick();
+            for(uint16_t i=0; i<cfg_ctrl->get_num_cfg(); i++) {
+                my_assert(m_dut->glb_to_cgra_cfg_wr[i], 0, "glb_to_cgra_cfg_wr");
+                my_assert(m_dut->glb_to_cgra_cfg_rd[i], 0, "glb_to_cgra_cfg_rd");
+            }
+        }
+        return cycles;
+    }
+
+    // Stream bitstream through num_channels of the NUM_CFG channels. It is
+    // split into equal contiguous parts, each stored at the first bank of the
+    // channel which streams it. The channels in between are switched off and
+    // repeat the one before them. Returns the cycles from config_start_pulse
+    // to config_done_pulse.
+    unsigned long bitstream_test(const std::vector<BITSTREAM_ENTRY> &bitstream, uint16_t num_channels) {
+        uint16_t banks_per_cfg = NUM_BANKS / NUM_CFG;
+        uint16_t stride = NUM_CFG / num_channels;
+        size_t words_per_channel = (bitstream.size() + num_channels - 1) / num_channels;
+        if (words_per_channel > ((size_t)banks_per_cfg << (BANK_ADDR_WIDTH-3))) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Bitstream of " << bitstream.size() << " words does not fit in "
+                      << num_channels << " channels" << std::endl;
+            fail();
+        }
+
+        CFG_CTRL *cfg_ctrl = new CFG_CTRL(NUM_CFG);
+        for (uint16_t c=0; c<num_channels; c++) {
+            uint16_t id = c * stride;
+            uint32_t start_addr = (uint32_t)(id * banks_per_cfg) << BANK_ADDR_WIDTH;
+            size_t first = std::min(c * words_per_channel, bitstream.size());
+            size_t last = std::min(first + words_per_channel, bitstream.size());
+            for (size_t w=first; w<last; w++)
+                glb->write_word(start_addr + 8*(w-first), bitstream_word(bitstream[w]));
+            cfg_ctrl->set_start_addr(id, start_addr);
+            cfg_ctrl->set_num_words(id, last - first);
+            cfg_ctrl->set_switch_sel(id, (1 << banks_per_cfg) - 1);
+        }
+
+        unsigned long beats = cfg_beats;
+        unsigned long cycles = test(cfg_ctrl);
+        delete cfg_ctrl;
+        my_assert(cfg_beats - beats, bitstream.size(), "bitstream words");
+        return cycles;
+    }
+
+    void jtag_test(uint32_t addr, uint32_t data, bool read=0, uint32_t read_delay=10) {
+        // why hurry?
+        tick(100);
+
+        TB_LOG(LOG_INFO, "JTAG configuration starts\n");
+
+
+        m_dut->glc_to_cgra_cfg_addr = addr;
+        m_dut->glc_to_cgra_cfg_data = data;
+        if (read) {
+            m_dut->glc_to_cgra_cfg_rd = 1;
+            tick(read_delay);
+            m_dut->glc_to_cgra_cfg_rd = 0;
+        }
+        else {
+            m_dut->glc_to_cgra_cfg_wr = 1;
+            tick();
+            m_dut->glc_to_cgra_cfg_wr = 0;
+        }
+        for(uint16_t i=0; i < NUM_CFG; i++) {
+            my_assert(m_dut->glb_to_cgra_cfg_data[i], data, "glb_to_cgra_cfg_data");
+            my_assert(m_dut->glb_to_cgra_cfg_addr[i], addr, "glb_to_cgra_cfg_addr");
+            if (read) {
+                my_assert(m_dut->glb_to_cgra_cfg_wr[i], 0, "glb_to_cgra_cfg_wr");
+                my_assert(m_dut->glb_to_cgra_cfg_rd[i], 1, "glb_to_cgra_cfg_rd");
+            }
+            else {
+                my_assert(m_dut->glb_to_cgra_cfg_wr[i], 1, "glb_to_cgra_cfg_wr");
+                my_assert(m_dut->glb_to_cgra_cfg_rd[i], 0, "glb_to_cgra_cfg_rd");
+            }
+        }
+
+
+        TB_LOG(LOG_INFO, "End JTAG configuration\n");
+        
+        // why hurry?
+        tick(100);
+    }
+
+private:
+    CFG_CTRL_MODEL *m_model = nullptr;
+
+    // Hand the inputs of this cycle to the model and compare what it
+    // predicts with the settled outputs of the DUT, then clock it. The
+    // bank data glb_read() just returned is only registered at the edge.
+    void model_check(void) {
+        CFG_CTRL_MODEL &m = *m_model;
+        m.reset = m_dut->reset;
+        m.config_start_pulse = m_dut->config_start_pulse;
+        for (uint16_t i=0; i<NUM_BANKS; i++)
+            m.bank_to_cfg_rd_data[i] = m_dut->bank_to_cfg_rd_data[i];
+        m.glc_to_cgra_cfg_wr = m_dut->glc_to_cgra_cfg_wr;
+        m.glc_to_cgra_cfg_rd = m_dut->glc_to_cgra_cfg_rd;
+        m.glc_to_cgra_cfg_addr = m_dut->glc_to_cgra_cfg_addr;
+        m.glc_to_cgra_cfg_data = m_dut->glc_to_cgra_cfg_data;
+        m.config_en = m_dut->config_en;
+        m.config_wr = m_dut->config_wr;
+        m.config_rd = m_dut->config_rd;
+        m.config_addr = m_dut->config_addr;
+        m.config_wr_data = m_dut->config_wr_data;
+        m.eval();
+
+        my_assert(m_dut->config_done_pulse, m.config_done_pulse, "config_done_pulse (model)");
+        my_assert(m_dut->config_rd_data, m.config_rd_data, "config_rd_data (model)");
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            my_assert(m_dut->cfg_to_bank_rd_en[i], m.cfg_to_bank_rd_en[i], "cfg_to_bank_rd_en (model)");
+            my_assert(m_dut->cfg_to_bank_rd_addr[i], m.cfg_to_bank_rd_addr[i], "cfg_to_bank_rd_addr (model)");
+        }
+        for (uint16_t i=0; i<NUM_CFG; i++) {
+            my_assert(m_dut->glb_to_cgra_cfg_wr[i], m.glb_to_cgra_cfg_wr[i], "glb_to_cgra_cfg_wr (model)");
+            my_assert(m_dut->glb_to_cgra_cfg_rd[i], m.glb_to_cgra_cfg_rd[i], "glb_to_cgra_cfg_rd (model)");
+            my_assert(m_dut->glb_to_cgra_cfg_addr[i], m.glb_to_cgra_cfg_addr[i], "glb_to_cgra_cfg_addr (model)");
+            my_assert(m_dut->glb_to_cgra_cfg_data[i], m.glb_to_cgra_cfg_data[i], "glb_to_cgra_cfg_data (model)");
+        }
+        m.clock();
+    }
+
+    void instream(CFG_CTRL* cfg_ctrl) {
+        for(uint16_t i=0; i < cfg_ctrl->get_num_cfg(); i++) {
+            uint32_t int_cnt = cfg_ctrl->get_int_cnt(i);
+            uint32_t int_addr = cfg_ctrl->get_int_addr(i);
+            uint32_t switch_sel = cfg_ctrl->get_switch_sel(i);
+            if (switch_sel != 0) {
+                if (int_cnt > 0) {
+                    cfg_ctrl->set_int_addr(i, int_addr + 8);
+                    cfg_ctrl->set_int_cnt(i, int_cnt - 1);
+                    TB_LOG(LOG_DEBUG, "Address generator number %d is streaming bitstream to CGRA.\n", i);
+                    TB_LOG(LOG_DEBUG, "\tBitstream addr: 0x%08x / Bitstream data: 0x%08x / Bitstream write : %01d\n", m_dut->glb_to_cgra_cfg_addr[i], m_dut->glb_to_cgra_cfg_data[i], m_dut->glb_to_cgra_cfg_wr[i]);
+                    log_event(EV_CFG_WR, i, m_dut->glb_to_cgra_cfg_addr[i], m_dut->glb_to_cgra_cfg_data[i]);
+                    // lane 0 is the bitstream data, lane 1 the address
+                    my_assert_word(((uint64_t) m_dut->glb_to_cgra_cfg_addr[i] << 32) | m_dut->glb_to_cgra_cfg_data[i], glb->read_word(int_addr), "glb_to_cgra_cfg", 32);
+                    my_assert(m_dut->glb_to_cgra_cfg_wr[i], 1, "glb_to_cgra_cfg_wr");
+                    cfg_beats++;
+                }
+            }
+            else {
+                if (i == 0) {
+                    std::cerr << std::endl;  // end the current line
+                    std::cerr << "First address generator should be turned on" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                TB_LOG(LOG_DEBUG, "Address generator number %d is streaming bitstream to CGRA.\n", i);
+                TB_LOG(LOG_DEBUG, "\tBitstream addr: 0x%08x / Bitstream data: 0x%08x / Bitstream write : %01d\n", m_dut->glb_to_cgra_cfg_addr[i], m_dut->glb_to_cgra_cfg_data[i], m_dut->glb_to_cgra_cfg_wr[i]);
+                my_assert(m_dut->glb_to_cgra_cfg_addr[i], m_dut->glb_to_cgra_cfg_addr[i-1], "glb_to_cgra_cfg_addr");
+                my_assert(m_dut->glb_to_cgra_cfg_data[i], m_dut->glb_to_cgra_cfg_data[i-1], "glb_to_cgra_cfg_data");
+                my_assert(m_dut->glb_to_cgra_cfg_wr[i], m_dut->glb_to_cgra_cfg_wr[i-1], "glb_to_cgra_cfg_wr");
+            }
+        }
+    }
+
+    void glb_update() {
+        glb_read();
+    }
+
+    void glb_read() {
+        bank_rd_queue.retire(m_tickcount, [this](const BANK_RD &rd) {
+            m_dut->bank_to_cfg_rd_data[rd.bank] = glb->read(rd.bank, rd.addr>>3);
+
+            TB_LOG(LOG_DEBUG, "Read data from bank %d\n", rd.bank);
+            TB_LOG(LOG_DEBUG, "\tData: 0x%016lx / Addr: 0x%08x\n", m_dut->bank_to_cfg_rd_data[rd.bank], rd.addr);
+            log_event(EV_BANK_RD, rd.bank, rd.addr, m_dut->bank_to_cfg_rd_data[rd.bank]);
+        });
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m_dut->cfg_to_bank_rd_en[i] == 1)
+                bank_rd_queue.push(m_tickcount, {i, m_dut->cfg_to_bank_rd_addr[i]});
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "port_probe.h"
+
+// Keeps the value of a set of probed signals for the last N cycles in a
+// ring buffer. Nothing touches the disk until dump() is called, so it can
+// stay on for full-speed regressions and still give a waveform of a failure.
+class FLIGHT_RECORDER : public PORT_PROBE {
+public:
+    // filter is a comma separated list of name prefixes. Empty keeps all.
+    FLIGHT_RECORDER(unsigned long depth, const std::string &filter="") {
+        m_depth = depth > 0 ? depth : 1;
+        m_count = 0;
+        m_head = 0;
+        m_cycles.assign(m_depth, 0);
+        size_t start = 0;
+        while (start < filter.size()) {
+            size_t end = filter.find(',', start);
+            if (end == std::string::npos)
+                end = filter.size();
+            if (end > start)
+                m_filter.push_back(filter.substr(start, end-start));
+            start = end + 1;
+        }
+    }
+
+    size_t num_probes(void) {
+        return m_probes.size();
+    }
+
+    void sample(unsigned long cycle) {
+        if (m_probes.empty())
+            return;
+        uint64_t *row = &m_buffer[m_head * m_probes.size()];
+        for (size_t i=0; i<m_probes.size(); i++) {
+            uint64_t value = 0;
+            memcpy(&value, m_probes[i].signal, m_probes[i].size);
+            row[i] = value;
+        }
+        m_cycles[m_head] = cycle;
+        m_head = (m_head + 1) % m_depth;
+        if (m_count < m_depth)
+            m_count++;
+    }
+
+    // Write the recorded cycles as a VCD using the same timestamps as
+    // TESTBENCH::tick(), i.e. sampled values appear at 10*cycle-4.
+    bool dump(const char *vcdname) {
+        if (m_probes.empty())
+            return false;
+        FILE *fp = fopen(vcdname, "w");
+        if (fp == NULL)
+            return false;
+        fprintf(fp, "$version Generated by FLIGHT_RECORDER $end\n");
+        fprintf(fp, "$timescale 1ps $end\n");
+        fprintf(fp, "$scope module TOP $end\n");
+        fprintf(fp, "$var wire 1 %s clk $end\n", vcd_id(0).c_str());
+        for (size_t i=0; i<m_probes.size(); i++) {
+            fprintf(fp, "$var wire %d %s %s $end\n", m_probes[i].width,
+                    vcd_id(i+1).c_str(), m_probes[i].name.c_str());
+        }
+        fprintf(fp, "$upscope $end\n");
+        fprintf(fp, "$enddefinitions $end\n");
+
+        unsigned long first = (m_head + m_depth - m_count) % m_depth;
+        const uint64_t *prev = NULL;
+        for (unsigned long n=0; n<m_count; n++) {
+            unsigned long slot = (first + n) % m_depth;
+            const uint64_t *row = &m_buffer[slot * m_probes.size()];
+            unsigned long cycle = m_cycles[slot];
+            fprintf(fp, "#%lu\n", 10*cycle-4);
+            for (size_t i=0; i<m_probes.size(); i++) {
+                if (prev != NULL && prev[i] == row[i])
+                    continue;
+                fprintf(fp, "b%s %s\n",
+                        to_binary(row[i], m_probes[i].width).c_str(),
+                        vcd_id(i+1).c_str());
+            }
+            fprintf(fp, "#%lu\n1%s\n", 10*cycle, vcd_id(0).c_str());
+            fprintf(fp, "#%lu\n0%s\n", 10*cycle+5, vcd_id(0).c_str());
+            prev = row;
+        }
+        fclose(fp);
+        return true;
+    }
+
+protected:
+    void add(const std::string &name, const void *signal, size_t size, int width) {
+        if (!selected(name))
+            return;
+        PROBE p;
+        p.name = name;
+        p.signal = signal;
+        p.size = size;
+        p.width = width;
+        m_probes.push_back(p);
+        m_buffer.assign(m_depth * m_probes.size(), 0);
+        m_count = 0;
+        m_head = 0;
+    }
+
+private:
+    struct PROBE {
+        std::string name;
+        const void  *signal;
+        size_t      size;
+        int         width;
+    };
+
+    unsigned long               m_depth;
+    unsigned long               m_count;
+    unsigned long               m_head;
+    std::vector<std::string>    m_filter;
+    std::vector<PROBE>          m_probes;
+    std::vector<uint64_t>       m_buffer;
+    std::vector<unsigned long>  m_cycles;
+
+    bool selected(const std::string &name) {
+        if (m_filter.empty())
+            return true;
+        for (const auto &prefix : m_filter) {
+            if (name.compare(0, prefix.size(), prefix) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static std::string vcd_id(size_t num) {
+        std::string id;
+        do {
+            id += (char)('!' + num % 94);
+            num /= 94;
+        } while (num > 0);
+        return id;
+    }
+
+    static std::string to_binary(uint64_t value, int width) {
+        std::string bits(width, '0');
+        for (int i=0; i<width; i++) {
+            if ((value >> i) & 1)
+                bits[width-1-i] = '1';
+        }
+        return bits;
+    }
+};
+
+#endif
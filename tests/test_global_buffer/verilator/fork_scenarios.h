@@ -0,0 +1,121 @@
+#ifndef FORK_SCENARIOS_H
+#define FORK_SCENARIOS_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Outcome of a scenario run in a child process
+struct FORK_RESULT {
+    unsigned        scenario;
+    bool            passed;
+    unsigned long   cycles;     // simulated by the scenario
+    double          seconds;
+    std::string     log;        // stdout and stderr of the child
+};
+
+// Runs scenario(0) ... scenario(num-1), each in a child process forked from
+// the current state of tb. The model, the shadow memory and the golden
+// model are shared copy-on-write, so whatever it took to get there is paid
+// once instead of num times. At most jobs children run at once, one per
+// core by default. Every child writes its output to <log_prefix>_<n>.log
+// and sends its result back over a pipe. A child that fails or dies sends
+// nothing and counts as failed.
+//
+// Threads do not survive fork(), so this is for models verilated without
+// --threads.
+template<class TB>
+std::vector<FORK_RESULT> fork_scenarios(TB *tb, unsigned num,
+                                        std::function<void(unsigned)> scenario,
+                                        unsigned jobs=0,
+                                        const std::string &log_prefix="scenario") {
+    struct MESSAGE {
+        unsigned long   cycles;
+        double          seconds;
+    };
+    struct CHILD {
+        unsigned        scenario;
+        int             fd;     // read end of its pipe
+    };
+
+    if (jobs == 0)
+        jobs = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    std::vector<FORK_RESULT> results(num);
+    std::map<pid_t, CHILD> running;
+    unsigned next = 0;
+    while (next < num || !running.empty()) {
+        if (next < num && running.size() < jobs) {
+            FORK_RESULT &result = results[next];
+            result.scenario = next;
+            result.passed = false;
+            result.cycles = 0;
+            result.seconds = 0;
+            result.log = log_prefix + "_" + std::to_string(next) + ".log";
+            int fds[2];
+            if (pipe(fds) != 0) {
+                perror("pipe");
+                exit(EXIT_FAILURE);
+            }
+            // nothing buffered may be written twice
+            fflush(NULL);
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                exit(EXIT_FAILURE);
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                int log = open(result.log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (log >= 0) {
+                    dup2(log, STDOUT_FILENO);
+                    dup2(log, STDERR_FILENO);
+                    close(log);
+                }
+                tb->forked(next);
+                unsigned long start = tb->tickcount();
+                auto t0 = std::chrono::steady_clock::now();
+                scenario(next);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+                MESSAGE msg = {tb->tickcount() - start, elapsed.count()};
+                fflush(NULL);
+                int rc = write(fds[1], &msg, sizeof(msg)) == sizeof(msg) ? EXIT_SUCCESS : EXIT_FAILURE;
+                // the parent's state is not ours to clean up
+                _exit(rc);
+            }
+            close(fds[1]);
+            running[pid] = {next, fds[0]};
+            next++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            perror("wait");
+            exit(EXIT_FAILURE);
+        }
+        auto child = running.find(pid);
+        if (child == running.end())
+            continue;
+        FORK_RESULT &result = results[child->second.scenario];
+        MESSAGE msg;
+        bool reported = read(child->second.fd, &msg, sizeof(msg)) == sizeof(msg);
+        close(child->second.fd);
+        running.erase(child);
+        if (reported && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+            result.passed = true;
+            result.cycles = msg.cycles;
+            result.seconds = msg.seconds;
+        }
+    }
+    return results;
+}
+
+#endif
@@ -0,0 +1,926 @@
+#ifndef GLB_TB_H
+#define GLB_TB_H
+
+// Testbench of global_buffer_int, shared by the test driver and the
+// benchmark drivers: RTL parameters, the IO/CFG controller models and GLB_TB.
+
+#include "Vglobal_buffer_int.h"
+#include "verilated.h"
+#include "testbench.h"
+#include "io_mode.h"
+#include "shadow_memory.h"
+#include "traffic_pattern.h"
+#include "io_trace.h"
+#include "bank_stats.h"
+#include <deque>
+#include <random>
+#include <string.h>
+#include <vector>
+
+// Address is byte addressable
+uint16_t NUM_BANKS = 32;
+uint16_t NUM_IO = 8;
+uint16_t NUM_CFG = 8;
+uint16_t BANK_ADDR_WIDTH = 17;
+uint16_t BANK_DATA_WIDTH = 64;
+uint16_t CGRA_DATA_WIDTH = 16;
+uint16_t CONFIG_TILE_WIDTH = 2;
+uint16_t CONFIG_FEATURE_WIDTH = 4;
+uint16_t CONFIG_REG_WIDTH = 4;
+uint16_t CFG_ADDR_WIDTH = 32;
+uint16_t CFG_DATA_WIDTH = 32;
+
+// Cycles from a config read request to valid data: registers are muxed
+// combinationally, SRAM data comes out of the bank macro a cycle later
+const unsigned CONFIG_RD_LATENCY = 0;
+const unsigned SRAM_CONFIG_RD_LATENCY = 1;
+
+using namespace std;
+
+GLB_SHADOW *glb;
+
+// Internal signals of global_buffer_int made public_flat_rd by
+// global_buffer_int.vlt
+#define GLB_INTERNAL(dut, name) (TB_ROOT(dut)->global_buffer_int__DOT__ ## name)
+
+typedef enum TILE
+{
+    TILE_IO     = 1,
+    TILE_CFG    = 2
+} TILE;
+
+typedef uint16_t FEATURE;
+
+typedef enum REG
+{
+    IO_REG_MODE             = 0,
+    IO_REG_START_ADDR       = 1,
+    IO_REG_NUM_WORDS        = 2,
+    IO_REG_SWITCH_SEL       = 3,
+    IO_REG_DONE_DELAY       = 4,
+    CFG_REG_START_ADDR      = 0,
+    CFG_REG_NUM_WORDS       = 1,
+    CFG_REG_SWITCH_SEL      = 2
+} REG;
+
+// Events of the binary event log (--event-log)
+typedef enum EVENT
+{
+    EV_HOST_WR           = 0,
+    EV_HOST_RD           = 1,
+    EV_CONFIG_WR         = 2,
+    EV_CONFIG_RD         = 3,
+    EV_SRAM_CONFIG_WR    = 4,
+    EV_SRAM_CONFIG_RD    = 5,
+    EV_IO_RD             = 6,
+    EV_IO_WR             = 7
+} EVENT;
+
+const char *EVENT_NAMES[] = {"host_wr", "host_rd", "glb_config_wr", "glb_config_rd", "glb_sram_config_wr", "glb_sram_config_rd", "io_to_cgra_rd", "cgra_to_io_wr"};
+
+
+class Addr_gen {
+public:
+    uint16_t id;
+    uint32_t start_addr;
+    uint32_t int_addr;
+    uint32_t num_words;
+    uint32_t int_cnt;
+    uint32_t switch_sel;
+
+    Addr_gen(uint32_t id) {
+        this->id = id;
+        start_addr = 0;
+        int_addr = 0;
+        int_cnt = 0;
+        num_words = 0;
+        switch_sel = 0;
+    }
+    virtual ~Addr_gen() {}
+};
+
+class IO_addr_gen: public Addr_gen {
+public:
+    MODE mode;
+    uint32_t done_delay;
+
+    IO_addr_gen(uint32_t id) : Addr_gen(id) {
+        mode = IDLE;
+        done_delay = 0;
+    }
+    ~IO_addr_gen() {}
+};
+
+class Cfg_addr_gen: public Addr_gen {
+public:
+    Cfg_addr_gen(uint32_t id): Addr_gen(id) {
+    }
+    ~Cfg_addr_gen() {}
+};
+
+class CFG_CTRL {
+public:
+    CFG_CTRL(uint16_t num_cfg) {
+        addr_gens = new Cfg_addr_gen*[num_cfg];
+        this->num_cfg = num_cfg;
+        for (uint16_t i=0; i<num_cfg; i++) {
+            addr_gens[i] = new Cfg_addr_gen(i);
+        }
+    }
+    ~CFG_CTRL(void) {
+        for (uint16_t i=0; i<num_cfg; i++)
+            delete addr_gens[i]; 
+        delete[] addr_gens;
+    }
+
+    uint16_t get_num_cfg() {
+        return this->num_cfg;
+    }
+
+    uint32_t get_start_addr(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->start_addr;
+    }
+
+    uint32_t get_int_addr(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->int_addr;
+    }
+
+    uint32_t get_num_words(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->num_words;
+    }
+
+    uint32_t get_int_cnt(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->int_cnt;
+    }
+
+    uint32_t get_switch_sel(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->switch_sel;
+    }
+
+    Cfg_addr_gen* get_addr_gen(uint16_t num_cfg) {
+        return addr_gens[num_cfg];
+    }
+
+    void set_start_addr(uint16_t num_cfg, uint32_t start_addr) {
+        if (start_addr % 8 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg]->start_addr = start_addr;
+    }
+
+    void set_int_addr(uint16_t num_cfg, uint32_t int_addr) {
+        if (int_addr % 8 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg]->int_addr = int_addr;
+    }
+
+    void set_num_words(uint16_t num_cfg, uint32_t num_words) {
+        addr_gens[num_cfg]->num_words = num_words;
+    }
+
+    void set_int_cnt(uint16_t num_cfg, uint32_t int_cnt) {
+        addr_gens[num_cfg]->int_cnt = int_cnt;
+    }
+
+    void set_switch_sel(uint16_t num_cfg, uint32_t switch_sel) {
+        if (switch_sel >= (1<<(NUM_BANKS/NUM_CFG)) ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "CFG controller " << num_cfg << "select switch cannot be configed to " << std::hex << "0x" << switch_sel <<  std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_cfg]->switch_sel = switch_sel;
+    }
+
+private:
+    Cfg_addr_gen **addr_gens;
+    uint16_t num_cfg;
+};
+
+class IO_CTRL {
+public:
+    IO_CTRL(uint16_t num_io) {
+        addr_gens = new IO_addr_gen*[num_io];
+        this->num_io = num_io;
+        for (uint16_t i=0; i<num_io; i++) {
+            addr_gens[i] = new IO_addr_gen(i);
+        }
+    }
+    ~IO_CTRL(void) {
+        for (uint16_t i=0; i<num_io; i++)
+            delete addr_gens[i]; 
+        delete[] addr_gens;
+    }
+
+    uint16_t get_num_io() {
+        return this->num_io;
+    }
+    MODE get_mode(uint16_t num_io) {
+        return addr_gens[num_io]->mode;
+    }
+    uint32_t get_start_addr(uint16_t num_io) {
+        return addr_gens[num_io]->start_addr;
+    }
+    uint32_t get_int_addr(uint16_t num_io) {
+        return addr_gens[num_io]->int_addr;
+    }
+    uint32_t get_num_words(uint16_t num_io) {
+        return addr_gens[num_io]->num_words;
+    }
+    uint32_t get_int_cnt(uint16_t num_io) {
+        return addr_gens[num_io]->int_cnt;
+    }
+    uint32_t get_switch_sel(uint16_t num_cfg) {
+        return addr_gens[num_cfg]->switch_sel;
+    }
+    IO_addr_gen* get_addr_gen(uint16_t num_io) {
+        return addr_gens[num_io];
+    }
+
+    void set_mode(uint16_t num_io, MODE mode) {
+        addr_gens[num_io]->mode = mode;
+    }
+    void set_start_addr(uint16_t num_io, uint32_t start_addr) {
+        if (start_addr % 2 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io]->start_addr = start_addr;
+    }
+
+    void set_int_addr(uint16_t num_io, uint32_t int_addr) {
+        if (int_addr % 2 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io]->int_addr = int_addr;
+    }
+
+    void set_num_words(uint16_t num_io, uint32_t num_words) {
+        addr_gens[num_io]->num_words = num_words;
+    }
+
+    void set_int_cnt(uint16_t num_io, uint32_t int_cnt) {
+        addr_gens[num_io]->int_cnt = int_cnt;
+    }
+    void set_switch_sel(uint16_t num_io, uint32_t switch_sel) {
+        if (switch_sel >= (1<<(NUM_BANKS/NUM_IO)) ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "IO controller " << num_io << "select switch cannot be configed to " << std::hex << "0x" << switch_sel <<  std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io]->switch_sel = switch_sel;
+    }
+private:
+    IO_addr_gen **addr_gens;
+    uint16_t num_io;
+};
+
+struct HOST_WR {
+    uint32_t strb;
+    uint32_t addr;
+    uint64_t data;
+};
+
+struct HOST_RD {
+    uint32_t addr;
+};
+
+class GLB_TB : public TESTBENCH<Vglobal_buffer_int> {
+public:
+    // host requests in flight, by cycles until they reach the bank
+    LATENCY_QUEUE<HOST_WR> host_wr_queue;
+    LATENCY_QUEUE<HOST_RD> host_rd_queue;
+    // patterns of glc_to_io_stall and of each channel's cgra_to_io_wr_en in
+    // cgra_test(), see make_traffic_pattern(). Empty keeps the defaults.
+    std::string stall_spec;
+    std::string wr_en_spec;
+
+    GLB_TB(unsigned host_wr_latency=1, unsigned host_rd_latency=2)
+        : host_wr_queue(host_wr_latency), host_rd_queue(host_rd_latency) {
+        for (uint16_t i=0; i<sizeof(EVENT_NAMES)/sizeof(EVENT_NAMES[0]); i++)
+            tb_log.define_event(i, EVENT_NAMES[i]);
+        m_io_trace = NULL;
+        m_bank_stats = NULL;
+        reset();
+    }
+
+    ~GLB_TB(void) {
+        close_io_trace();
+        delete m_bank_stats;
+    }
+
+    // Count the requests of every bank from now on, see BANK_STATS
+    BANK_STATS *enable_bank_stats(void) {
+        if (!m_bank_stats)
+            m_bank_stats = new BANK_STATS(NUM_BANKS);
+        return m_bank_stats;
+    }
+
+    BANK_STATS *bank_stats(void) {
+        return m_bank_stats;
+    }
+
+    // Record the CGRA side inputs of every cycle from now on, to be played
+    // back with io_replay()
+    void open_io_trace(const char *filename) {
+        close_io_trace();
+        m_io_trace = new IO_TRACE_WRITER(filename, NUM_IO);
+    }
+
+    void close_io_trace(void) {
+        if (m_io_trace) {
+            printf("IO trace: %lu cycles\n", m_io_trace->cycles());
+            delete m_io_trace;
+            m_io_trace = NULL;
+        }
+    }
+
+    // The IO trace stays with the parent as well
+    void forked(unsigned scenario) {
+        TESTBENCH::forked(scenario);
+        m_io_trace = NULL;
+    }
+
+    void update() {
+        if (m_io_trace) m_io_trace->sample(m_dut);
+        if (m_bank_stats) bank_stats_update();
+        if (!checking())
+            return;
+        // nothing to model while no host request is in flight
+        if (m_dut->host_wr_strb == 0 && m_dut->host_rd_en == 0
+                && host_wr_queue.empty() && host_rd_queue.empty())
+            return;
+        host_update();
+    }
+
+#ifdef TB_SAVABLE
+    // The host requests in flight and the shadow memory go with the model
+    void save_state(VerilatedSerialize &os) {
+        host_wr_queue.save(os);
+        host_rd_queue.save(os);
+        glb->save(os);
+    }
+
+    void restore_state(VerilatedDeserialize &os) {
+        host_wr_queue.restore(os);
+        host_rd_queue.restore(os);
+        if (!glb->restore(os)) {
+            std::cerr << "Checkpoint of a GLB with different NUM_BANKS or BANK_ADDR_WIDTH" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
+
+    void probe_ports(PORT_PROBE *recorder) {
+        recorder->probe("reset", &m_dut->reset, 1);
+        recorder->probe("host_wr_strb", &m_dut->host_wr_strb, BANK_DATA_WIDTH/8);
+        recorder->probe("host_wr_addr", &m_dut->host_wr_addr, 32);
+        recorder->probe("host_wr_data", &m_dut->host_wr_data, BANK_DATA_WIDTH);
+        recorder->probe("host_rd_en", &m_dut->host_rd_en, 1);
+        recorder->probe("host_rd_addr", &m_dut->host_rd_addr, 32);
+        recorder->probe("host_rd_data", &m_dut->host_rd_data, BANK_DATA_WIDTH);
+        recorder->probe("cgra_to_io_wr_en", m_dut->cgra_to_io_wr_en, NUM_IO, 1);
+        recorder->probe("cgra_to_io_rd_en", m_dut->cgra_to_io_rd_en, NUM_IO, 1);
+        recorder->probe("io_to_cgra_rd_data_valid", m_dut->io_to_cgra_rd_data_valid, NUM_IO, 1);
+        recorder->probe("cgra_to_io_wr_data", m_dut->cgra_to_io_wr_data, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("io_to_cgra_rd_data", m_dut->io_to_cgra_rd_data, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("cgra_to_io_addr_high", m_dut->cgra_to_io_addr_high, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("cgra_to_io_addr_low", m_dut->cgra_to_io_addr_low, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("glc_to_cgra_cfg_wr", &m_dut->glc_to_cgra_cfg_wr, 1);
+        recorder->probe("glc_to_cgra_cfg_rd", &m_dut->glc_to_cgra_cfg_rd, 1);
+        recorder->probe("glc_to_cgra_cfg_addr", &m_dut->glc_to_cgra_cfg_addr, CFG_ADDR_WIDTH);
+        recorder->probe("glc_to_cgra_cfg_data", &m_dut->glc_to_cgra_cfg_data, CFG_DATA_WIDTH);
+        recorder->probe("glb_to_cgra_cfg_wr", m_dut->glb_to_cgra_cfg_wr, NUM_CFG, 1);
+        recorder->probe("glb_to_cgra_cfg_rd", m_dut->glb_to_cgra_cfg_rd, NUM_CFG, 1);
+        recorder->probe("glb_to_cgra_cfg_addr", m_dut->glb_to_cgra_cfg_addr, NUM_CFG, CFG_ADDR_WIDTH);
+        recorder->probe("glb_to_cgra_cfg_data", m_dut->glb_to_cgra_cfg_data, NUM_CFG, CFG_DATA_WIDTH);
+        recorder->probe("glc_to_io_stall", &m_dut->glc_to_io_stall, 1);
+        recorder->probe("cgra_start_pulse", &m_dut->cgra_start_pulse, 1);
+        recorder->probe("cgra_done_pulse", &m_dut->cgra_done_pulse, 1);
+        recorder->probe("config_start_pulse", &m_dut->config_start_pulse, 1);
+        recorder->probe("config_done_pulse", &m_dut->config_done_pulse, 1);
+        recorder->probe("glb_config_wr", &m_dut->glb_config_wr, 1);
+        recorder->probe("glb_config_rd", &m_dut->glb_config_rd, 1);
+        recorder->probe("glb_config_addr", &m_dut->glb_config_addr, 12);
+        recorder->probe("glb_config_wr_data", &m_dut->glb_config_wr_data, CFG_DATA_WIDTH);
+        recorder->probe("glb_config_rd_data", &m_dut->glb_config_rd_data, CFG_DATA_WIDTH);
+        recorder->probe("glb_sram_config_wr", &m_dut->glb_sram_config_wr, 1);
+        recorder->probe("glb_sram_config_rd", &m_dut->glb_sram_config_rd, 1);
+        recorder->probe("glb_sram_config_addr", &m_dut->glb_sram_config_addr, CFG_ADDR_WIDTH);
+        recorder->probe("glb_sram_config_wr_data", &m_dut->glb_sram_config_wr_data, CFG_DATA_WIDTH);
+        recorder->probe("glb_sram_config_rd_data", &m_dut->glb_sram_config_rd_data, CFG_DATA_WIDTH);
+    }
+
+    void host_write(uint16_t bank, uint32_t addr, uint64_t data_in, uint32_t wr_strb=0b11111111) {
+        m_dut->host_wr_strb = wr_strb;
+        m_dut->host_wr_data = data_in;
+        uint32_t int_addr = (bank << BANK_ADDR_WIDTH) + addr % (1 << BANK_ADDR_WIDTH);
+        m_dut->host_wr_addr = int_addr;
+        tick();
+        TB_LOG(LOG_DEBUG, "HOST is writing - Bank: %d / Data: 0x%016lx / Addr: 0x%04x / Strobe: 0x%02x\n", bank, data_in, addr, wr_strb);
+        m_dut->host_wr_strb = 0;
+    }
+
+    void host_read(uint16_t bank, uint32_t addr) {
+        m_dut->host_rd_en = 1;
+        uint32_t int_addr = addr % (1 << BANK_ADDR_WIDTH) + (bank << BANK_ADDR_WIDTH);
+        m_dut->host_rd_addr = int_addr;
+        tick();
+        TB_LOG(LOG_DEBUG, "HOST is reading from bank %d, addr: 0x%04x.\n", bank, addr);
+        m_dut->host_rd_en = 0;
+    }
+
+    // TODO: Can make it better
+    void glb_config_wr(IO_CTRL* io_ctrl) {
+        for (uint16_t i=0; i<io_ctrl->get_num_io(); i++) {
+            glb_config_wr(io_ctrl->get_addr_gen(i));
+        }
+    }
+    void glb_config_wr(CFG_CTRL* cfg_ctrl) {
+        for (uint16_t i=0; i<cfg_ctrl->get_num_cfg(); i++) {
+            glb_config_wr(cfg_ctrl->get_addr_gen(i));
+        }
+    }
+
+    void glb_config_wr(Addr_gen* addr_gen) {
+        TILE tile;
+        FEATURE feature;
+        REG reg;
+        if (dynamic_cast<Cfg_addr_gen*>(addr_gen) != NULL) {
+            Cfg_addr_gen *tmp_addr_gen = dynamic_cast<Cfg_addr_gen*>(addr_gen);
+            tile = TILE_CFG; 
+            glb_config_wr(tile, tmp_addr_gen->id, CFG_REG_START_ADDR, tmp_addr_gen->start_addr);
+            glb_config_wr(tile, tmp_addr_gen->id, CFG_REG_NUM_WORDS, tmp_addr_gen->num_words);
+            glb_config_wr(tile, tmp_addr_gen->id, CFG_REG_SWITCH_SEL, tmp_addr_gen->switch_sel);
+        }
+        else if (dynamic_cast<IO_addr_gen*>(addr_gen) != NULL) {
+            IO_addr_gen *tmp_addr_gen = dynamic_cast<IO_addr_gen*>(addr_gen);
+            tile = TILE_IO; 
+            glb_config_wr(tile, tmp_addr_gen->id, IO_REG_MODE, tmp_addr_gen->mode);
+            glb_config_wr(tile, tmp_addr_gen->id, IO_REG_START_ADDR, tmp_addr_gen->start_addr);
+            glb_config_wr(tile, tmp_addr_gen->id, IO_REG_NUM_WORDS, tmp_addr_gen->num_words);
+            glb_config_wr(tile, tmp_addr_gen->id, IO_REG_SWITCH_SEL, tmp_addr_gen->switch_sel);
+            glb_config_wr(tile, tmp_addr_gen->id, IO_REG_DONE_DELAY, tmp_addr_gen->done_delay);
+        }
+        else {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Wrong address generator" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void glb_config_wr(TILE tile, FEATURE feature, REG reg, uint32_t data) {
+        uint32_t addr = ((tile << (CONFIG_REG_WIDTH+CONFIG_FEATURE_WIDTH))
+                      + (feature << (CONFIG_REG_WIDTH))
+                      + reg) << 2;
+        glb_config_wr(addr, data);
+    }
+
+    void glb_config_wr(uint32_t addr, uint32_t data) {
+        m_dut->glb_config_wr = 1;
+        m_dut->glb_config_addr = addr;
+        m_dut->glb_config_wr_data = data;
+        tick();
+        m_dut->glb_config_wr = 0;
+        m_config_cycles++;
+        TB_LOG(LOG_DEBUG, "Config global buffer. Data: 0x%08x / Addr: 0x%08x\n", data, addr);
+        log_event(EV_CONFIG_WR, 0, addr, data);
+    }
+
+    // TODO: Can make it better
+    void glb_config_rd(IO_CTRL* io_ctrl) {
+        for (uint16_t i=0; i<io_ctrl->get_num_io(); i++) {
+            glb_config_rd(io_ctrl->get_addr_gen(i));
+        }
+    }
+    void glb_config_rd(CFG_CTRL* cfg_ctrl) {
+        for (uint16_t i=0; i<cfg_ctrl->get_num_cfg(); i++) {
+            glb_config_rd(cfg_ctrl->get_addr_gen(i));
+        }
+    }
+
+    void glb_config_rd(Addr_gen* addr_gen) {
+        TILE tile;
+        FEATURE feature;
+        REG reg;
+        if (dynamic_cast<Cfg_addr_gen*>(addr_gen) != NULL) {
+            Cfg_addr_gen *tmp_addr_gen = dynamic_cast<Cfg_addr_gen*>(addr_gen);
+            tile = TILE_CFG; 
+            glb_config_rd(tile, tmp_addr_gen->id, CFG_REG_START_ADDR, tmp_addr_gen->start_addr);
+            glb_config_rd(tile, tmp_addr_gen->id, CFG_REG_NUM_WORDS, tmp_addr_gen->num_words);
+            glb_config_rd(tile, tmp_addr_gen->id, CFG_REG_SWITCH_SEL, tmp_addr_gen->switch_sel);
+        }
+        else if (dynamic_cast<IO_addr_gen*>(addr_gen) != NULL) {
+            IO_addr_gen *tmp_addr_gen = dynamic_cast<IO_addr_gen*>(addr_gen);
+            tile = TILE_IO; 
+            glb_config_rd(tile, tmp_addr_gen->id, IO_REG_MODE, tmp_addr_gen->mode);
+            glb_config_rd(tile, tmp_addr_gen->id, IO_REG_START_ADDR, tmp_addr_gen->start_addr);
+            glb_config_rd(tile, tmp_addr_gen->id, IO_REG_NUM_WORDS, tmp_addr_gen->num_words);
+            glb_config_rd(tile, tmp_addr_gen->id, IO_REG_SWITCH_SEL, tmp_addr_gen->switch_sel);
+            glb_config_rd(tile, tmp_addr_gen->id, IO_REG_DONE_DELAY, tmp_addr_gen->done_delay);
+        }
+        else {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Wrong address generator" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Register reads are muxed combinationally, so this takes a single
+    // cycle and the next access follows right after
+    void glb_config_rd(TILE tile, FEATURE feature, REG reg, uint32_t data_expected) {
+        uint32_t addr = ((tile << (CONFIG_REG_WIDTH+CONFIG_FEATURE_WIDTH))
+                      + (feature << (CONFIG_REG_WIDTH))
+                      + reg) << 2;
+        m_dut->glb_config_rd = 1;
+        m_dut->glb_config_addr = addr;
+        m_config_cycles += read_at_latency(CONFIG_RD_LATENCY, [&]() {
+            my_assert(m_dut->glb_config_rd_data, data_expected, "config_rd_data");
+        });
+        m_dut->glb_config_rd = 0;
+
+        TB_LOG(LOG_DEBUG, "Config read global buffer. Data: 0x%08x / Addr: 0x%08x\n", m_dut->glb_config_rd_data, addr);
+        log_event(EV_CONFIG_RD, 0, addr, m_dut->glb_config_rd_data);
+    }
+
+    void config_sram_wr(uint16_t bank, uint32_t addr, uint32_t data) {
+        if (addr % 0b100 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address should be aligned to 32bit word size for configuration" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+        uint32_t int_addr = (addr % (1 << BANK_ADDR_WIDTH)) + (bank << BANK_ADDR_WIDTH);
+        m_dut->glb_sram_config_wr = 1;
+        m_dut->glb_sram_config_addr = int_addr;
+        m_dut->glb_sram_config_wr_data = data;
+        tick();
+        m_dut->glb_sram_config_wr = 0;
+        m_config_cycles++;
+        glb->write_bytes(int_addr, 4, data);
+        TB_LOG(LOG_DEBUG, "Config writing SRAM. Bank: %d / Data: 0x%08x / Addr: 0x%08x\n", bank, data, addr);
+        log_event(EV_SRAM_CONFIG_WR, bank, int_addr, data);
+    }
+
+    // The data comes out of the bank macro, so it is valid one cycle after
+    // the request (SRAM_CONFIG_RD_LATENCY)
+    void config_sram_rd(uint16_t bank, uint32_t addr) {
+        if (addr % 0b100 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address should be aligned to 32bit word size for configuration" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+        uint32_t int_addr = (addr % (1 << BANK_ADDR_WIDTH)) + (bank << BANK_ADDR_WIDTH);
+        m_dut->glb_sram_config_rd = 1;
+        m_dut->glb_sram_config_addr = int_addr;
+        uint32_t data_expected = glb->read_bytes(int_addr, 4);
+        m_config_cycles += read_at_latency(SRAM_CONFIG_RD_LATENCY, [&]() {
+            TB_LOG(LOG_DEBUG, "Config reading SRAM. Bank: %d / Data: 0x%08x / Addr: 0x%08x\n", bank, m_dut->glb_sram_config_rd_data, addr);
+            log_event(EV_SRAM_CONFIG_RD, bank, int_addr, m_dut->glb_sram_config_rd_data);
+            my_assert(m_dut->glb_sram_config_rd_data, data_expected, "config_rd_data");
+        });
+        m_dut->glb_sram_config_rd = 0;
+    }
+
+    void io_ctrl_setup(IO_CTRL* io_ctrl) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                TB_LOG(LOG_INFO, "Address generator %d : OUTSTREAM\n", i);
+                io_ctrl->set_int_addr(i, io_ctrl->get_start_addr(i));
+                io_ctrl->set_int_cnt(i, io_ctrl->get_num_words(i));
+            }
+            else if (io_ctrl->get_mode(i) == INSTREAM) {
+                TB_LOG(LOG_INFO, "Address generator %d : INSTREAM\n", i);
+                io_ctrl->set_int_addr(i, io_ctrl->get_start_addr(i));
+                io_ctrl->set_int_cnt(i, io_ctrl->get_num_words(i));
+            }
+            else if (io_ctrl->get_mode(i) == SRAM)
+                TB_LOG(LOG_INFO, "Address generator %d : SRAM\n", i);
+            else
+                TB_LOG(LOG_INFO, "Address generator %d : IDLE\n", i);
+        }
+    }
+
+    void cgra_test(IO_CTRL* io_ctrl, uint32_t latency=10, uint32_t stall_cycle=0) {
+        // why hurry?
+        tick(100);
+
+        uint32_t max_num_words = 0;
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) != IDLE) {
+                max_num_words = std::max(io_ctrl->get_num_words(i), max_num_words);
+            }
+        }
+        uint16_t* wr_data_array = new uint16_t[max_num_words];
+
+        // if stall_cycle is non-zero, randomly stall for stall_cycle cycles,
+        // unless stall_spec gives a pattern
+        std::string stall_default = "off";
+        if (stall_cycle != 0 && max_num_words > 0)
+            stall_default = "window:" + std::to_string(max((rand() % max_num_words)/2, (uint32_t)2))
+                            + ":" + std::to_string(stall_cycle);
+        unsigned seed = rand();
+        TRAFFIC_PATTERN *stall = make_traffic_pattern(stall_spec.empty() ? stall_default : stall_spec, seed);
+        std::vector<TRAFFIC_PATTERN*> wr_en(io_ctrl->get_num_io());
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            wr_en[i] = make_traffic_pattern(wr_en_spec.empty() ? "bernoulli:0.5" : wr_en_spec, seed + i + 1);
+
+        std::vector<CHANNEL_LOAD> load(io_ctrl->get_num_io(), CHANNEL_LOAD{0, 0});
+        auto account = [&]() {
+            for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+                if ((io_ctrl->get_mode(i) == INSTREAM || io_ctrl->get_mode(i) == OUTSTREAM)
+                        && io_ctrl->get_int_cnt(i) > 0) {
+                    load[i].busy_cycles++;
+                    load[i].stall_cycles += m_dut->glc_to_io_stall;
+                }
+            }
+        };
+
+        for (uint32_t i=0; i<max_num_words; i++)
+            //wr_data_array[i] = (uint16_t)rand(); 
+            wr_data_array[i] = (uint16_t)i; 
+
+        // toggle cgra_start_pulse
+        m_dut->cgra_start_pulse = 1;
+        tick();
+        m_dut->cgra_start_pulse = 0;
+
+        // internal counter and address set to num_words and start_address
+        io_ctrl_setup(io_ctrl);
+
+        // latency of read
+        tick();
+
+        // latency of application
+        for (uint32_t t=0; t<latency; t++) {
+            tick();
+            account();
+            instream(io_ctrl);
+        }
+
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                m_dut->cgra_to_io_wr_en[i] = 1;
+                m_dut->cgra_to_io_wr_data[i] = wr_data_array[0];
+            }
+        }
+
+        TB_LOG(LOG_INFO, "IO Controller starts\n");
+
+        uint32_t num_cnt = 0;
+        // traffic patterns may hold off most cycles, so allow plenty of
+        // cycles per word
+        uint32_t max_cycles = 100*max_num_words + stall_cycle + 1000;
+        m_dut->glc_to_io_stall = stall->next();
+        run_until([this]() { return m_dut->cgra_done_pulse == 1; }, max_cycles,
+                  [&]() {
+                      account();
+                      instream(io_ctrl);
+                      outstream(io_ctrl, wr_data_array, num_cnt, wr_en);
+                      m_dut->glc_to_io_stall = stall->next();
+                  }, "cgra_done_pulse");
+        m_dut->glc_to_io_stall = 0;
+        delete stall;
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            delete wr_en[i];
+
+        // check whether data is correctly written to glb
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                // address increase by 2 (byte addressable)
+                uint32_t start_addr = io_ctrl->get_start_addr(i);
+                uint32_t num_words = io_ctrl->get_num_words(i);
+                uint32_t j = glb->compare16(start_addr, wr_data_array, num_words);
+                if (j != num_words)
+                    my_assert(glb->read_bytes(start_addr + 2*j, 2), wr_data_array[j], "glb");
+            }
+        }
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            print_channel_throughput(i, io_ctrl->get_num_words(i), load[i]);
+        TB_LOG(LOG_INFO, "End IO controller\n");
+        
+        // why hurry?
+        tick(100);
+    }
+
+    void cgra_wr_sram(uint16_t num_io, uint16_t wr_en, uint32_t addr, uint32_t data) {
+        m_dut->cgra_to_io_wr_en[num_io] = wr_en;
+        m_dut->cgra_to_io_wr_data[num_io] = data;
+        m_dut->cgra_to_io_addr_high[num_io] = (uint16_t)(addr>>16);
+        m_dut->cgra_to_io_addr_low[num_io] = (uint16_t)addr;
+        glb->write_bytes(addr, 2, data);
+        TB_LOG(LOG_DEBUG, "CGRA is writing data to IO controller.\n");
+        TB_LOG(LOG_DEBUG, "\tData: 0x%04x / Addr: 0x%08x\n", data, addr);
+    }
+
+    void cgra_rd_sram(uint16_t num_io, uint16_t rd_en, uint32_t addr) {
+        m_dut->cgra_to_io_rd_en[num_io] = rd_en;
+        m_dut->cgra_to_io_addr_high[num_io] = (uint16_t)(addr>>16);
+        m_dut->cgra_to_io_addr_low[num_io] = (uint16_t)addr;
+        TB_LOG(LOG_DEBUG, "CGRA is reading data from IO controller.\n");
+        TB_LOG(LOG_DEBUG, "\tAddr: 0x%08x\n", addr);
+    }
+
+    // Drive the CGRA side inputs from an IO trace, one record per cycle, and
+    // check io_to_cgra_rd_data against the shadow memory. Writes of the trace
+    // go to the shadow memory as well. The buffer has to be configured with
+    // io_ctrl and hold the same data as in the recorded run. Returns the
+    // number of cycles played back.
+    unsigned long io_replay(IO_CTRL* io_ctrl, const char *filename) {
+        IO_TRACE_READER trace(filename);
+        if (trace.num_io() != io_ctrl->get_num_io()) {
+            std::cerr << "IO trace " << filename << " has " << trace.num_io()
+                      << " channels instead of " << io_ctrl->get_num_io() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        uint16_t num_io = io_ctrl->get_num_io();
+        std::vector<uint32_t> sram_cnt(num_io, 0);
+        std::vector<std::deque<uint16_t> > sram_rd(num_io);
+        // SRAM reads complete in order, when valid shows up
+        auto retire = [&]() {
+            for (uint16_t i=0; i<num_io; i++) {
+                if (io_ctrl->get_mode(i) != SRAM || m_dut->io_to_cgra_rd_data_valid[i] != 1)
+                    continue;
+                my_assert(sram_rd[i].empty(), 0, "io_to_cgra_rd_data_valid");
+                my_assert(m_dut->io_to_cgra_rd_data[i], sram_rd[i].front(), "io_to_cgra_rd_data");
+                sram_rd[i].pop_front();
+            }
+        };
+        IO_TRACE_CYCLE cycle;
+        // instream data is checked from the second cycle after
+        // cgra_start_pulse, as in cgra_test()
+        unsigned long since_start = 0;
+        unsigned long cycles = 0;
+        while (trace.next(cycle)) {
+            m_dut->glc_to_io_stall = cycle.stall;
+            m_dut->cgra_start_pulse = cycle.start;
+            for (uint16_t i=0; i<num_io; i++) {
+                m_dut->cgra_to_io_wr_en[i] = cycle.wr_en[i];
+                m_dut->cgra_to_io_rd_en[i] = cycle.rd_en[i];
+                if (cycle.wr_en[i] || cycle.rd_en[i]) {
+                    m_dut->cgra_to_io_addr_high[i] = cycle.addr_high[i];
+                    m_dut->cgra_to_io_addr_low[i] = cycle.addr_low[i];
+                }
+                if (cycle.wr_en[i])
+                    m_dut->cgra_to_io_wr_data[i] = cycle.wr_data[i];
+            }
+            tick();
+            cycles++;
+
+            if (cycle.start) {
+                io_ctrl_setup(io_ctrl);
+                for (uint16_t i=0; i<num_io; i++)
+                    sram_cnt[i] = io_ctrl->get_mode(i) == SRAM ? io_ctrl->get_num_words(i) : 0;
+                since_start = 1;
+                continue;
+            }
+            if (since_start == 0)
+                continue;
+            if (++since_start > 2)
+                instream(io_ctrl);
+            retire();
+
+            for (uint16_t i=0; i<num_io; i++) {
+                if (cycle.stall || !(cycle.wr_en[i] || cycle.rd_en[i]))
+                    continue;
+                uint32_t addr = ((uint32_t)cycle.addr_high[i] << 16) | cycle.addr_low[i];
+                if (io_ctrl->get_mode(i) == OUTSTREAM && cycle.wr_en[i] && io_ctrl->get_int_cnt(i) > 0) {
+                    log_event(EV_IO_WR, i, io_ctrl->get_int_addr(i), cycle.wr_data[i]);
+                    glb->write_bytes(io_ctrl->get_int_addr(i), 2, cycle.wr_data[i]);
+                    io_ctrl->set_int_addr(i, io_ctrl->get_int_addr(i) + 2);
+                    io_ctrl->set_int_cnt(i, io_ctrl->get_int_cnt(i) - 1);
+                }
+                else if (io_ctrl->get_mode(i) == SRAM && sram_cnt[i] > 0) {
+                    if (cycle.wr_en[i]) {
+                        log_event(EV_IO_WR, i, addr, cycle.wr_data[i]);
+                        glb->write_bytes(addr, 2, cycle.wr_data[i]);
+                    }
+                    if (cycle.rd_en[i])
+                        sram_rd[i].push_back(glb->read_bytes(addr, 2));
+                    sram_cnt[i]--;
+                }
+            }
+        }
+
+        // the last reads are still in flight
+        for (uint16_t i=0; i<num_io; i++) {
+            m_dut->cgra_to_io_wr_en[i] = 0;
+            m_dut->cgra_to_io_rd_en[i] = 0;
+        }
+        m_dut->glc_to_io_stall = 0;
+        m_dut->cgra_start_pulse = 0;
+        run_while([&]() {
+                      for (uint16_t i=0; i<num_io; i++) {
+                          if (!sram_rd[i].empty())
+                              return true;
+                      }
+                      return false;
+                  }, 100, retire, "io_to_cgra_rd_data_valid");
+        return cycles;
+    }
+
+private:
+    void instream(IO_CTRL* io_ctrl) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == INSTREAM) {
+                uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                uint32_t int_addr = io_ctrl->get_int_addr(i);
+                if (int_cnt > 0) {
+                    if (m_dut->glc_to_io_stall == 0) {
+                        io_ctrl->set_int_addr(i, int_addr + 2);
+                        io_ctrl->set_int_cnt(i, int_cnt - 1);
+                    }
+                    else {
+                        int_addr = int_addr - 2;
+                    }
+                    TB_LOG(LOG_DEBUG, "Address generator number %d is streaming data to CGRA.\n", i);
+                    TB_LOG(LOG_DEBUG, "\tData: 0x%04x / Addr: 0x%08x / Valid: %01d\n", m_dut->io_to_cgra_rd_data[i], int_addr, m_dut->io_to_cgra_rd_data_valid[i]);
+                    log_event(EV_IO_RD, i, int_addr, m_dut->io_to_cgra_rd_data[i]);
+                    my_assert(m_dut->io_to_cgra_rd_data[i], glb->read_bytes(int_addr, 2), "io_to_cgra_rd_data");
+                    my_assert(m_dut->io_to_cgra_rd_data_valid[i], 1, "io_to_cgra_rd_data_valid");
+                }
+            }
+        }
+    }
+
+    void outstream(IO_CTRL* io_ctrl, uint16_t *data_array, uint32_t &num_cnt, std::vector<TRAFFIC_PATTERN*> &wr_en) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                bool next_wr_en = wr_en[i]->next();
+                uint32_t int_addr = io_ctrl->get_int_addr(i);
+                uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                TB_LOG(LOG_DEBUG, "CGRA is writing data to IO controller.\n");
+                TB_LOG(LOG_DEBUG, "\tData: 0x%04x / Addr: 0x%08x / Valid: %01d\n", m_dut->cgra_to_io_wr_data[i], int_addr, m_dut->cgra_to_io_wr_en[i]);
+                if (m_dut->glc_to_io_stall == 0) {
+                    if (m_dut->cgra_to_io_wr_en[i] == 1) {
+                        log_event(EV_IO_WR, i, int_addr, m_dut->cgra_to_io_wr_data[i]);
+                        glb->write_bytes(int_addr, 2, m_dut->cgra_to_io_wr_data[i]);
+                        io_ctrl->set_int_addr(i, int_addr + 2);
+                        io_ctrl->set_int_cnt(i, int_cnt - 1);
+                        m_dut->cgra_to_io_wr_data[i] = data_array[++num_cnt];
+                    }
+                    if (io_ctrl->get_int_cnt(i) == 0)
+                        m_dut->cgra_to_io_wr_en[i] = 0;
+                    else
+                        m_dut->cgra_to_io_wr_en[i] = next_wr_en;
+                }
+            }
+        }
+    }
+
+    IO_TRACE_WRITER *m_io_trace;
+    BANK_STATS      *m_bank_stats;
+
+    void bank_stats_update() {
+        m_bank_stats->cycle();
+        bool sram_config = m_dut->glb_sram_config_wr || m_dut->glb_sram_config_rd;
+        uint32_t sram_config_bank = m_dut->glb_sram_config_addr >> BANK_ADDR_WIDTH;
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            uint8_t requests = ((sram_config && i == sram_config_bank) << REQ_SRAM_CONFIG)
+                | ((GLB_INTERNAL(m_dut, host_to_bank_wr_en)[i] & 1) << REQ_HOST_WR)
+                | ((GLB_INTERNAL(m_dut, host_to_bank_rd_en)[i] & 1) << REQ_HOST_RD)
+                | ((GLB_INTERNAL(m_dut, cfg_to_bank_rd_en)[i] & 1) << REQ_CFG_RD)
+                | ((GLB_INTERNAL(m_dut, io_to_bank_wr_en)[i] & 1) << REQ_IO_WR)
+                | ((GLB_INTERNAL(m_dut, io_to_bank_rd_en)[i] & 1) << REQ_IO_RD);
+            m_bank_stats->sample(i, requests);
+        }
+    }
+
+    void host_update() {
+        host_write();
+        host_read();
+    }
+
+    void host_read() {
+        host_rd_queue.retire(m_tickcount, [this](const HOST_RD &rd) {
+            my_assert_word(m_dut->host_rd_data, glb->read_word(rd.addr), "host_rd_data");
+            log_event(EV_HOST_RD, glb->bank(rd.addr), rd.addr, m_dut->host_rd_data);
+            TB_LOG(LOG_DEBUG, "Read data from bank %d / Data: 0x%016lx / Addr: 0x%08x\n", glb->bank(rd.addr), m_dut->host_rd_data, rd.addr % (1 << BANK_ADDR_WIDTH));
+        });
+        if (m_dut->host_rd_en == 1)
+            host_rd_queue.push(m_tickcount, {m_dut->host_rd_addr});
+    }
+
+    void host_write() {
+        host_wr_queue.retire(m_tickcount, [this](const HOST_WR &wr) {
+            glb->write_word(wr.addr, wr.data, GLB_SHADOW::strb_mask(wr.strb));
+            log_event(EV_HOST_WR, glb->bank(wr.addr), wr.addr, wr.data);
+            TB_LOG(LOG_DEBUG, "Write data to bank %d / Data: 0x%016lx / Strb: 0x%02x, Addr: 0x%08x\n", glb->bank(wr.addr), wr.data, wr.strb, wr.addr);
+        });
+        if (m_dut->host_wr_strb != 0)
+            host_wr_queue.push(m_tickcount, {m_dut->host_wr_strb, m_dut->host_wr_addr, m_dut->host_wr_data});
+    }
+
+};
+
+#endif
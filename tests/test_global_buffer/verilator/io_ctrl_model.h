@@ -0,0 +1,731 @@
+#ifndef IO_CTRL_MODEL_H
+#define IO_CTRL_MODEL_H
+
+// Cycle-accurate C++ models of io_address_generator and io_controller
+// (global_buffer/genesis). They take no Verilator model and run orders of
+// magnitude faster than the RTL, to sweep the address space standalone or
+// to predict every output of the DUT in IO_CTRL_TB.
+//
+// Like a Verilated model, a model has its ports as public members: set the
+// inputs, eval() to settle the outputs, then clock() for the rising edge.
+// clock() uses the values of the last eval(). Registers without a reset in
+// the RTL start out as 0, like they do in Verilator.
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include "io_mode.h"
+
+static inline uint64_t model_mask(unsigned width) {
+    return width >= 64 ? ~0ULL : (1ULL << width) - 1;
+}
+
+class IO_ADDR_GEN_MODEL {
+public:
+    // inputs
+    uint8_t     reset;
+    uint8_t     clk_en;
+    uint8_t     cgra_start_pulse;
+    uint32_t    start_addr;
+    uint32_t    num_words;
+    uint8_t     mode;
+    uint32_t    done_delay;
+    uint8_t     cgra_to_io_wr_en;
+    uint8_t     cgra_to_io_rd_en;
+    uint16_t    cgra_to_io_wr_data;
+    uint16_t    cgra_to_io_addr_high;
+    uint16_t    cgra_to_io_addr_low;
+    uint64_t    bank_to_io_rd_data;
+    uint8_t     bank_to_io_rd_data_valid;
+
+    // outputs
+    uint8_t     cgra_done_pulse;
+    uint16_t    io_to_cgra_rd_data;
+    uint8_t     io_to_cgra_rd_data_valid;
+    uint8_t     io_to_bank_wr_en;
+    uint64_t    io_to_bank_wr_data;
+    uint64_t    io_to_bank_wr_data_bit_sel;
+    uint8_t     io_to_bank_rd_en;
+    uint32_t    io_to_bank_addr;
+
+    IO_ADDR_GEN_MODEL(unsigned bank_data_width=64, unsigned cgra_data_width=16,
+                      unsigned glb_addr_width=32) {
+        if (bank_data_width > 64 || cgra_data_width > 16 || glb_addr_width > 32
+                || cgra_data_width % 8 != 0 || bank_data_width % cgra_data_width != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "IO_ADDR_GEN_MODEL does not support BANK_DATA_WIDTH " << bank_data_width
+                      << ", CGRA_DATA_WIDTH " << cgra_data_width
+                      << ", GLB_ADDR_WIDTH " << glb_addr_width << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_cgra_data_width = cgra_data_width;
+        m_cgra_data_byte = cgra_data_width / 8;
+        m_cgra_data_mask = model_mask(cgra_data_width);
+        m_data_sel_mask = bank_data_width / cgra_data_width - 1;
+        m_glb_addr_width = glb_addr_width;
+        m_glb_addr_mask = (uint32_t)model_mask(glb_addr_width);
+        m_bank_addr_mask = m_glb_addr_mask & ~(uint32_t)(bank_data_width / 8 - 1);
+
+        reset = 0;
+        clk_en = 1;
+        cgra_start_pulse = 0;
+        start_addr = num_words = done_delay = 0;
+        mode = IDLE;
+        cgra_to_io_wr_en = cgra_to_io_rd_en = 0;
+        cgra_to_io_wr_data = cgra_to_io_addr_high = cgra_to_io_addr_low = 0;
+        bank_to_io_rd_data = 0;
+        bank_to_io_rd_data_valid = 0;
+        m_state = STATE();
+        eval();
+    }
+
+    // Settle the outputs. The reset is asynchronous like in the RTL.
+    void eval(void) {
+        if (reset)
+            async_reset(m_state);
+        const STATE &s = m_state;
+
+        m_int_rd_data = s.rd_en_d2 ? bank_to_io_rd_data : s.rd_data_reg;
+        m_int_rd_data_valid = s.rd_en_d2 ? bank_to_io_rd_data_valid : s.rd_data_valid_reg;
+
+        // SRAM mode takes the address and the enables from the CGRA
+        uint32_t addr_sram = sram_addr();
+        uint8_t wr_en_sram = 0, rd_en_sram = 0;
+        uint64_t wr_data_sram = 0, bit_sel_sram = 0;
+        if (s.state_sram == RUN) {
+            unsigned shift = lane(addr_sram);
+            wr_en_sram = cgra_to_io_wr_en;
+            rd_en_sram = cgra_to_io_rd_en;
+            wr_data_sram = (uint64_t)cgra_to_io_wr_data << shift;
+            bit_sel_sram = m_cgra_data_mask << shift;
+        }
+
+        cgra_done_pulse = 0;
+        io_to_cgra_rd_data = 0;
+        io_to_cgra_rd_data_valid = 0;
+        io_to_bank_wr_en = 0;
+        io_to_bank_wr_data = 0;
+        io_to_bank_wr_data_bit_sel = 0;
+        io_to_bank_rd_en = 0;
+        io_to_bank_addr = 0;
+        switch (mode) {
+        case INSTREAM:
+            io_to_cgra_rd_data = rd_lane(s.data_sel_instream_d2);
+            io_to_cgra_rd_data_valid = m_int_rd_data_valid & s.rd_data_valid_instream_d2;
+            io_to_bank_rd_en = s.rd_en_instream;
+            io_to_bank_addr = s.addr_instream & m_bank_addr_mask;
+            cgra_done_pulse = s.done_pulse_instream;
+            break;
+        case OUTSTREAM:
+            io_to_bank_wr_en = s.wr_en_outstream;
+            io_to_bank_wr_data = s.wr_data_outstream;
+            io_to_bank_wr_data_bit_sel = s.bit_sel_outstream;
+            io_to_bank_addr = s.bank_addr_outstream;
+            cgra_done_pulse = s.done_pulse_outstream;
+            break;
+        case SRAM:
+            io_to_cgra_rd_data = rd_lane(s.data_sel_sram_d2);
+            io_to_cgra_rd_data_valid = m_int_rd_data_valid & s.rd_en_sram_d2;
+            io_to_bank_wr_en = wr_en_sram;
+            io_to_bank_wr_data = wr_data_sram;
+            io_to_bank_wr_data_bit_sel = bit_sel_sram;
+            io_to_bank_rd_en = rd_en_sram;
+            io_to_bank_addr = addr_sram & m_bank_addr_mask;
+            cgra_done_pulse = s.done_pulse_sram;
+            break;
+        }
+        if (!clk_en) {
+            io_to_bank_wr_en = 0;
+            io_to_bank_rd_en = 0;
+        }
+    }
+
+    // Rising edge of clk
+    void clock(void) {
+        const STATE &s = m_state;
+        STATE n = s;
+        if (clk_en) {
+            n.rd_en_d1 = io_to_bank_rd_en;
+            n.rd_en_d2 = s.rd_en_d1;
+            n.rd_data_reg = m_int_rd_data;
+            n.rd_data_valid_reg = m_int_rd_data_valid;
+            n.rd_data_valid_instream_d1 = s.num_words_instream > 0;
+            n.rd_data_valid_instream_d2 = s.rd_data_valid_instream_d1;
+            n.data_sel_instream_d1 = data_sel(s.addr_instream);
+            n.data_sel_instream_d2 = s.data_sel_instream_d1;
+            n.data_sel_sram_d1 = data_sel(sram_addr());
+            n.data_sel_sram_d2 = s.data_sel_sram_d1;
+            n.rd_en_sram_d1 = s.state_sram == RUN && cgra_to_io_rd_en;
+            n.rd_en_sram_d2 = s.rd_en_sram_d1;
+        }
+        if (reset) {
+            async_reset(n);
+        }
+        else if (clk_en) {
+            clock_instream(s, n);
+            clock_outstream(s, n);
+            clock_sram(s, n);
+        }
+        m_state = n;
+    }
+
+private:
+    // States of the three FSMs
+    enum FSM_STATE {
+        START   = 0,    // IDLE_INSTREAM, IDLE_OUTSTREAM, IDLE_SRAM
+        RUN     = 1,    // READ_INSTREAM, WRITE_OUTSTREAM, RUN_SRAM
+        DONE    = 2
+    };
+
+    struct STATE {
+        // bank read data, shared by INSTREAM and SRAM
+        uint8_t     rd_en_d1 = 0;
+        uint8_t     rd_en_d2 = 0;
+        uint64_t    rd_data_reg = 0;
+        uint8_t     rd_data_valid_reg = 0;
+
+        uint8_t     state_instream = START;
+        uint32_t    num_words_instream = 0;
+        uint32_t    done_cnt_instream = 0;
+        uint32_t    addr_instream = 0;
+        uint8_t     rd_en_instream = 0;
+        uint8_t     done_pulse_instream = 0;
+        uint8_t     rd_data_valid_instream_d1 = 0;
+        uint8_t     rd_data_valid_instream_d2 = 0;
+        uint8_t     data_sel_instream_d1 = 0;
+        uint8_t     data_sel_instream_d2 = 0;
+
+        uint8_t     state_outstream = START;
+        uint32_t    num_words_outstream = 0;
+        uint32_t    done_cnt_outstream = 0;
+        uint32_t    addr_outstream = 0;
+        uint8_t     wr_en_outstream = 0;
+        uint64_t    wr_data_outstream = 0;
+        uint64_t    bit_sel_outstream = 0;
+        uint32_t    bank_addr_outstream = 0;
+        uint8_t     done_pulse_outstream = 0;
+
+        uint8_t     state_sram = START;
+        uint32_t    num_words_sram = 0;
+        uint32_t    done_cnt_sram = 0;
+        uint8_t     done_pulse_sram = 0;
+        uint8_t     rd_en_sram_d1 = 0;
+        uint8_t     rd_en_sram_d2 = 0;
+        uint8_t     data_sel_sram_d1 = 0;
+        uint8_t     data_sel_sram_d2 = 0;
+    };
+
+    unsigned    m_cgra_data_width;
+    unsigned    m_cgra_data_byte;
+    uint64_t    m_cgra_data_mask;
+    unsigned    m_data_sel_mask;
+    unsigned    m_glb_addr_width;
+    uint32_t    m_glb_addr_mask;
+    uint32_t    m_bank_addr_mask;
+
+    STATE       m_state;
+    uint64_t    m_int_rd_data;
+    uint8_t     m_int_rd_data_valid;
+
+    unsigned data_sel(uint32_t addr) const {
+        return (addr >> (m_cgra_data_byte - 1)) & m_data_sel_mask;
+    }
+
+    unsigned lane(uint32_t addr) const {
+        return data_sel(addr) * m_cgra_data_width;
+    }
+
+    uint16_t rd_lane(unsigned sel) const {
+        return (m_int_rd_data >> (sel * m_cgra_data_width)) & m_cgra_data_mask;
+    }
+
+    // {addr_high, addr_low}, addr_high cut to what fits GLB_ADDR_WIDTH
+    uint32_t sram_addr(void) const {
+        uint32_t high = (uint32_t)cgra_to_io_addr_high & (uint32_t)model_mask(m_glb_addr_width - m_cgra_data_width);
+        return ((high << m_cgra_data_width) | cgra_to_io_addr_low) & m_glb_addr_mask;
+    }
+
+    static void async_reset(STATE &s) {
+        s.state_instream = START;
+        s.num_words_instream = 0;
+        s.done_cnt_instream = 0;
+        s.addr_instream = 0;
+        s.rd_en_instream = 0;
+        s.done_pulse_instream = 0;
+
+        s.state_outstream = START;
+        s.num_words_outstream = 0;
+        s.done_cnt_outstream = 0;
+        s.addr_outstream = 0;
+        s.wr_en_outstream = 0;
+        s.wr_data_outstream = 0;
+        s.bit_sel_outstream = 0;
+        s.bank_addr_outstream = 0;
+        s.done_pulse_outstream = 0;
+
+        s.state_sram = START;
+        s.num_words_sram = 0;
+        s.done_cnt_sram = 0;
+        s.done_pulse_sram = 0;
+    }
+
+    void clock_instream(const STATE &s, STATE &n) {
+        n.rd_en_instream = 0;
+        n.done_pulse_instream = 0;
+        if (mode != INSTREAM) {
+            n.state_instream = START;
+            n.num_words_instream = 0;
+            n.done_cnt_instream = 0;
+            return;
+        }
+        switch (s.state_instream) {
+        case START:
+            if (cgra_start_pulse) {
+                n.state_instream = num_words > 0 ? RUN : DONE;
+                n.num_words_instream = num_words;
+                n.done_cnt_instream = done_delay;
+                n.addr_instream = start_addr;
+                n.rd_en_instream = num_words > 0;
+            }
+            else {
+                n.num_words_instream = 0;
+                n.done_cnt_instream = 0;
+            }
+            break;
+        case RUN:
+            if (s.num_words_instream == 1) {
+                n.state_instream = DONE;
+                n.num_words_instream = 0;
+            }
+            else {
+                n.num_words_instream = s.num_words_instream - 1;
+                n.addr_instream = (s.addr_instream + m_cgra_data_byte) & m_glb_addr_mask;
+                // the bank is read again once the last word of it is
+                n.rd_en_instream = data_sel(s.addr_instream) == m_data_sel_mask;
+            }
+            break;
+        case DONE:
+            if (s.done_cnt_instream == 0) {
+                n.state_instream = START;
+                n.done_pulse_instream = 1;
+            }
+            else {
+                n.done_cnt_instream = s.done_cnt_instream - 1;
+            }
+            n.num_words_instream = 0;
+            break;
+        default:
+            n.state_instream = START;
+            n.num_words_instream = 0;
+            n.done_cnt_instream = 0;
+            break;
+        }
+    }
+
+    void clock_outstream(const STATE &s, STATE &n) {
+        n.wr_en_outstream = 0;
+        n.done_pulse_outstream = 0;
+        if (mode != OUTSTREAM) {
+            n.state_outstream = START;
+            n.num_words_outstream = 0;
+            n.done_cnt_outstream = 0;
+            n.bit_sel_outstream = 0;
+            return;
+        }
+        switch (s.state_outstream) {
+        case START:
+            if (cgra_start_pulse) {
+                n.state_outstream = num_words > 0 ? RUN : DONE;
+                n.num_words_outstream = num_words;
+                n.done_cnt_outstream = done_delay;
+                n.addr_outstream = start_addr;
+            }
+            else {
+                n.num_words_outstream = 0;
+                n.done_cnt_outstream = 0;
+            }
+            n.wr_data_outstream = 0;
+            n.bit_sel_outstream = 0;
+            n.bank_addr_outstream = 0;
+            break;
+        case RUN:
+            if (cgra_to_io_wr_en) {
+                unsigned sel = data_sel(s.addr_outstream);
+                unsigned shift = sel * m_cgra_data_width;
+                uint64_t lane_mask = m_cgra_data_mask << shift;
+                // a partial word only goes to the bank once it is full or
+                // the stream ends
+                bool last = s.num_words_outstream == 1;
+                n.wr_data_outstream = (s.wr_data_outstream & ~lane_mask)
+                                      | ((uint64_t)cgra_to_io_wr_data << shift);
+                if (sel == 0 && !last)
+                    n.bit_sel_outstream = m_cgra_data_mask;
+                else
+                    n.bit_sel_outstream = s.bit_sel_outstream | lane_mask;
+                if (last || sel == m_data_sel_mask) {
+                    n.wr_en_outstream = 1;
+                    n.bank_addr_outstream = s.addr_outstream & m_bank_addr_mask;
+                }
+                if (last) {
+                    n.state_outstream = DONE;
+                    n.num_words_outstream = 0;
+                }
+                else {
+                    n.num_words_outstream = s.num_words_outstream - 1;
+                    n.addr_outstream = (s.addr_outstream + m_cgra_data_byte) & m_glb_addr_mask;
+                }
+            }
+            break;
+        case DONE:
+            if (s.done_cnt_outstream == 0) {
+                n.state_outstream = START;
+                n.done_pulse_outstream = 1;
+            }
+            else {
+                n.done_cnt_outstream = s.done_cnt_outstream - 1;
+            }
+            n.num_words_outstream = 0;
+            n.bit_sel_outstream = 0;
+            break;
+        default:
+            n.state_outstream = START;
+            n.num_words_outstream = 0;
+            n.bit_sel_outstream = 0;
+            break;
+        }
+    }
+
+    void clock_sram(const STATE &s, STATE &n) {
+        n.done_pulse_sram = 0;
+        if (mode != SRAM) {
+            n.state_sram = START;
+            n.num_words_sram = 0;
+            n.done_cnt_sram = 0;
+            return;
+        }
+        // there is no default branch, state 3 is never left
+        switch (s.state_sram) {
+        case START:
+            if (cgra_start_pulse) {
+                n.state_sram = num_words > 0 ? RUN : DONE;
+                n.num_words_sram = num_words;
+                n.done_cnt_sram = done_delay;
+            }
+            else {
+                n.num_words_sram = 0;
+                n.done_cnt_sram = 0;
+            }
+            break;
+        case RUN:
+            // every CGRA access counts, a write and a read in the same cycle
+            // once
+            if (cgra_to_io_wr_en || cgra_to_io_rd_en) {
+                if (s.num_words_sram == 1) {
+                    n.state_sram = DONE;
+                    n.num_words_sram = 0;
+                }
+                else {
+                    n.num_words_sram = s.num_words_sram - 1;
+                }
+            }
+            break;
+        case DONE:
+            if (s.done_cnt_sram == 0) {
+                n.state_sram = START;
+                n.done_cnt_sram = 0;
+                n.done_pulse_sram = 1;
+            }
+            else {
+                n.done_cnt_sram = s.done_cnt_sram - 1;
+            }
+            n.num_words_sram = 0;
+            break;
+        }
+    }
+};
+
+// io_controller: the config registers, one IO_ADDR_GEN_MODEL per channel,
+// the switch_sel chains to the banks and the read network back.
+class IO_CTRL_MODEL {
+public:
+    // inputs
+    uint8_t                 reset;
+    uint8_t                 cgra_start_pulse;
+    uint8_t                 glc_to_io_stall;
+    std::vector<uint8_t>    cgra_to_io_wr_en;
+    std::vector<uint8_t>    cgra_to_io_rd_en;
+    std::vector<uint16_t>   cgra_to_io_wr_data;
+    std::vector<uint16_t>   cgra_to_io_addr_high;
+    std::vector<uint16_t>   cgra_to_io_addr_low;
+    std::vector<uint64_t>   bank_to_io_rd_data;
+    uint8_t                 config_en;
+    uint8_t                 config_wr;
+    uint8_t                 config_rd;
+    uint32_t                config_addr;
+    uint32_t                config_wr_data;
+
+    // outputs
+    uint8_t                 cgra_done_pulse;
+    std::vector<uint8_t>    io_to_cgra_rd_data_valid;
+    std::vector<uint16_t>   io_to_cgra_rd_data;
+    std::vector<uint8_t>    io_to_bank_wr_en;
+    std::vector<uint64_t>   io_to_bank_wr_data;
+    std::vector<uint64_t>   io_to_bank_wr_data_bit_sel;
+    std::vector<uint32_t>   io_to_bank_wr_addr;
+    std::vector<uint8_t>    io_to_bank_rd_en;
+    std::vector<uint32_t>   io_to_bank_rd_addr;
+    uint32_t                config_rd_data;
+
+    IO_CTRL_MODEL(unsigned num_banks=32, unsigned num_io=8, unsigned bank_addr_width=17,
+                  unsigned bank_data_width=64, unsigned cgra_data_width=16,
+                  unsigned glb_addr_width=32, unsigned config_feature_width=4,
+                  unsigned config_reg_width=4)
+        : m_gens(num_io, IO_ADDR_GEN_MODEL(bank_data_width, cgra_data_width, glb_addr_width)) {
+        m_num_banks = num_banks;
+        m_num_io = num_io;
+        m_banks_per_io = (num_banks + num_io - 1) / num_io;
+        if (m_banks_per_io * num_io != num_banks || num_io > 32) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "IO_CTRL_MODEL needs the banks evenly split over at most 32 channels" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_bank_addr_width = bank_addr_width;
+        m_glb_addr_mask = (uint32_t)model_mask(glb_addr_width);
+        m_config_reg_width = config_reg_width;
+        m_config_feature_mask = (uint32_t)model_mask(config_feature_width);
+
+        reset = 0;
+        cgra_start_pulse = 0;
+        glc_to_io_stall = 0;
+        cgra_to_io_wr_en.assign(num_io, 0);
+        cgra_to_io_rd_en.assign(num_io, 0);
+        cgra_to_io_wr_data.assign(num_io, 0);
+        cgra_to_io_addr_high.assign(num_io, 0);
+        cgra_to_io_addr_low.assign(num_io, 0);
+        bank_to_io_rd_data.assign(num_banks, 0);
+        config_en = config_wr = config_rd = 0;
+        config_addr = config_wr_data = 0;
+
+        io_to_cgra_rd_data_valid.assign(num_io, 0);
+        io_to_cgra_rd_data.assign(num_io, 0);
+        io_to_bank_wr_en.assign(num_banks, 0);
+        io_to_bank_wr_data.assign(num_banks, 0);
+        io_to_bank_wr_data_bit_sel.assign(num_banks, 0);
+        io_to_bank_wr_addr.assign(num_banks, 0);
+        io_to_bank_rd_en.assign(num_banks, 0);
+        io_to_bank_rd_addr.assign(num_banks, 0);
+
+        m_cfg.assign(num_io, CONFIG());
+        m_done_reg = 0;
+        m_done_all = m_done_all_d1 = 0;
+        m_rd_en_d1.assign(num_banks, 0);
+        m_rd_en_d2.assign(num_banks, 0);
+        m_rd_data_d1.assign(num_banks, 0);
+        m_chain_rd_data.assign(num_banks, 0);
+        m_chain_rd_data_valid.assign(num_banks, 0);
+        eval();
+    }
+
+    unsigned num_banks(void) const {
+        return m_num_banks;
+    }
+
+    unsigned num_io(void) const {
+        return m_num_io;
+    }
+
+    unsigned banks_per_io(void) const {
+        return m_banks_per_io;
+    }
+
+    const IO_ADDR_GEN_MODEL &addr_gen(unsigned i) const {
+        return m_gens[i];
+    }
+
+    // Settle the outputs
+    void eval(void) {
+        if (reset) {
+            m_cfg.assign(m_num_io, CONFIG());
+            m_done_reg = 0;
+        }
+        uint8_t clk_en = !glc_to_io_stall;
+
+        // read network, from the last bank down: a bank returning data
+        // covers the ones below it
+        uint64_t rd_data = 0;
+        uint8_t rd_data_valid = 0;
+        for (unsigned k=m_num_banks; k-- > 0;) {
+            if (m_rd_en_d2[k]) {
+                rd_data = m_rd_data_d1[k];
+                rd_data_valid = 1;
+            }
+            m_chain_rd_data[k] = rd_data;
+            m_chain_rd_data_valid[k] = rd_data_valid;
+        }
+
+        for (unsigned j=0; j<m_num_io; j++) {
+            IO_ADDR_GEN_MODEL &gen = m_gens[j];
+            const CONFIG &cfg = m_cfg[j];
+            gen.reset = reset;
+            gen.clk_en = clk_en;
+            gen.cgra_start_pulse = cgra_start_pulse;
+            gen.start_addr = cfg.start_addr;
+            gen.num_words = cfg.num_words;
+            gen.mode = cfg.mode;
+            gen.done_delay = cfg.done_delay;
+            gen.cgra_to_io_wr_en = cgra_to_io_wr_en[j];
+            gen.cgra_to_io_rd_en = cgra_to_io_rd_en[j];
+            gen.cgra_to_io_wr_data = cgra_to_io_wr_data[j];
+            gen.cgra_to_io_addr_high = cgra_to_io_addr_high[j];
+            gen.cgra_to_io_addr_low = cgra_to_io_addr_low[j];
+            // a channel reads through the first bank it is switched to
+            gen.bank_to_io_rd_data = 0;
+            gen.bank_to_io_rd_data_valid = 0;
+            for (unsigned k=0; k<m_banks_per_io; k++) {
+                if ((cfg.switch_sel >> k) & 1) {
+                    gen.bank_to_io_rd_data = m_chain_rd_data[j*m_banks_per_io + k];
+                    gen.bank_to_io_rd_data_valid = m_chain_rd_data_valid[j*m_banks_per_io + k];
+                    break;
+                }
+            }
+            gen.eval();
+            io_to_cgra_rd_data[j] = gen.io_to_cgra_rd_data;
+            io_to_cgra_rd_data_valid[j] = gen.io_to_cgra_rd_data_valid;
+        }
+
+        // write and address network: a bank takes the channel it is
+        // switched to, otherwise whatever the bank below it has
+        uint32_t addr = 0;
+        uint8_t wr_en = 0, rd_en = 0;
+        uint64_t wr_data = 0, bit_sel = 0;
+        for (unsigned k=0; k<m_num_banks; k++) {
+            unsigned j = k / m_banks_per_io;
+            if ((m_cfg[j].switch_sel >> (k % m_banks_per_io)) & 1) {
+                const IO_ADDR_GEN_MODEL &gen = m_gens[j];
+                addr = gen.io_to_bank_addr;
+                wr_en = gen.io_to_bank_wr_en;
+                rd_en = gen.io_to_bank_rd_en;
+                wr_data = gen.io_to_bank_wr_data;
+                bit_sel = gen.io_to_bank_wr_data_bit_sel;
+            }
+            bool hit = (addr >> m_bank_addr_width) == k;
+            io_to_bank_wr_en[k] = wr_en && hit;
+            io_to_bank_rd_en[k] = rd_en && hit;
+            io_to_bank_wr_data[k] = wr_data;
+            io_to_bank_wr_data_bit_sel[k] = bit_sel;
+            io_to_bank_wr_addr[k] = addr & (uint32_t)model_mask(m_bank_addr_width);
+            io_to_bank_rd_addr[k] = io_to_bank_wr_addr[k];
+        }
+
+        // done once every channel that is not IDLE is
+        bool all_off = true;
+        m_done_all = 1;
+        for (unsigned j=0; j<m_num_io; j++) {
+            if (m_cfg[j].mode != IDLE) {
+                all_off = false;
+                m_done_all &= (m_done_reg >> j) & 1;
+            }
+        }
+        if (all_off)
+            m_done_all = 0;
+        cgra_done_pulse = m_done_all && !m_done_all_d1;
+
+        config_rd_data = 0;
+        unsigned feature = (config_addr >> m_config_reg_width) & m_config_feature_mask;
+        if (config_en && config_rd && feature < m_num_io)
+            config_rd_data = config_reg(m_cfg[feature], config_addr & (uint32_t)model_mask(m_config_reg_width));
+    }
+
+    // Rising edge of clk
+    void clock(void) {
+        uint8_t clk_en = !glc_to_io_stall;
+        for (unsigned j=0; j<m_num_io; j++) {
+            if (cgra_start_pulse)
+                continue;
+            if (m_gens[j].cgra_done_pulse)
+                m_done_reg |= 1u << j;
+        }
+        if (cgra_start_pulse)
+            m_done_reg = 0;
+        m_done_all_d1 = m_done_all;
+
+        if (clk_en) {
+            for (unsigned k=0; k<m_num_banks; k++) {
+                m_rd_en_d2[k] = m_rd_en_d1[k];
+                m_rd_en_d1[k] = io_to_bank_rd_en[k];
+                m_rd_data_d1[k] = bank_to_io_rd_data[k];
+            }
+        }
+        for (unsigned j=0; j<m_num_io; j++)
+            m_gens[j].clock();
+
+        unsigned feature = (config_addr >> m_config_reg_width) & m_config_feature_mask;
+        if (config_en && config_wr && feature < m_num_io) {
+            CONFIG &cfg = m_cfg[feature];
+            switch (config_addr & model_mask(m_config_reg_width)) {
+            case 0: cfg.mode = config_wr_data & 0x3; break;
+            case 1: cfg.start_addr = config_wr_data & m_glb_addr_mask; break;
+            case 2: cfg.num_words = config_wr_data & m_glb_addr_mask; break;
+            case 3: cfg.switch_sel = config_wr_data & (uint32_t)model_mask(m_banks_per_io); break;
+            case 4: cfg.done_delay = config_wr_data; break;
+            }
+        }
+        if (reset) {
+            m_cfg.assign(m_num_io, CONFIG());
+            m_done_reg = 0;
+        }
+    }
+
+    // Program channel i directly, as the config writes would
+    void configure(unsigned i, MODE mode, uint32_t start_addr, uint32_t num_words,
+                   uint32_t switch_sel, uint32_t done_delay=0) {
+        CONFIG &cfg = m_cfg[i];
+        cfg.mode = mode;
+        cfg.start_addr = start_addr & m_glb_addr_mask;
+        cfg.num_words = num_words & m_glb_addr_mask;
+        cfg.switch_sel = switch_sel & (uint32_t)model_mask(m_banks_per_io);
+        cfg.done_delay = done_delay;
+    }
+
+private:
+    struct CONFIG {
+        uint8_t     mode = IDLE;
+        uint32_t    start_addr = 0;
+        uint32_t    num_words = 0;
+        uint32_t    switch_sel = 0;
+        uint32_t    done_delay = 0;
+    };
+
+    unsigned                        m_num_banks;
+    unsigned                        m_num_io;
+    unsigned                        m_banks_per_io;
+    unsigned                        m_bank_addr_width;
+    uint32_t                        m_glb_addr_mask;
+    unsigned                        m_config_reg_width;
+    uint32_t                        m_config_feature_mask;
+
+    std::vector<IO_ADDR_GEN_MODEL>  m_gens;
+    std::vector<CONFIG>             m_cfg;
+    uint32_t                        m_done_reg;
+    uint8_t                         m_done_all;
+    uint8_t                         m_done_all_d1;
+    std::vector<uint8_t>            m_rd_en_d1;
+    std::vector<uint8_t>            m_rd_en_d2;
+    std::vector<uint64_t>           m_rd_data_d1;
+    std::vector<uint64_t>           m_chain_rd_data;
+    std::vector<uint8_t>            m_chain_rd_data_valid;
+
+    static uint32_t config_reg(const CONFIG &cfg, uint32_t reg) {
+        switch (reg) {
+        case 0: return cfg.mode;
+        case 1: return cfg.start_addr;
+        case 2: return cfg.num_words;
+        case 3: return cfg.switch_sel;
+        case 4: return cfg.done_delay;
+        default: return 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,540 @@
+#ifndef IO_CTRL_TB_H
+#define IO_CTRL_TB_H
+
+// Testbench of io_controller, shared by the test driver and the speed
+// benchmark: RTL parameters, the IO controller model and IO_CTRL_TB.
+
+#include "Vio_controller.h"
+#include "verilated.h"
+#include "testbench.h"
+#include "io_ctrl_model.h"
+#include "shadow_memory.h"
+#include "traffic_pattern.h"
+#include "time.h"
+#include <vector>
+#include <random>
+#include <string.h>
+
+// Address is byte addressable
+uint16_t NUM_BANKS = 32;
+uint16_t NUM_IO = 8;
+uint16_t BANK_ADDR_WIDTH = 17;
+uint16_t BANK_DATA_WIDTH = 64;
+uint16_t CGRA_DATA_WIDTH = 16;
+uint16_t GLB_ADDR_WIDTH = 32;
+uint16_t CONFIG_FEATURE_WIDTH = 4;
+uint16_t CONFIG_REG_WIDTH = 4;
+
+// Cycles from a config read request to valid data, registers are muxed
+// combinationally
+const unsigned CONFIG_RD_LATENCY = 0;
+
+using namespace std;
+
+GLB_SHADOW *glb;
+
+typedef enum REG_ID
+{
+    ID_MODE            = 0,
+    ID_START_ADDR      = 1,
+    ID_NUM_WORDS       = 2,
+    ID_SWITCH_SEL      = 3,
+    ID_DONE_DELAY      = 4
+} REG_ID;
+
+// Events of the binary event log (--event-log)
+typedef enum EVENT
+{
+    EV_IO_RD      = 0,
+    EV_IO_WR      = 1,
+    EV_BANK_RD    = 2,
+    EV_BANK_WR    = 3
+} EVENT;
+
+const char *EVENT_NAMES[] = {"io_to_cgra_rd", "cgra_to_io_wr", "bank_to_io_rd", "io_to_bank_wr"};
+
+struct Addr_gen
+{
+    uint16_t id;
+    MODE mode;
+    uint32_t start_addr;
+    uint32_t int_addr;
+    uint32_t num_words;
+    uint32_t int_cnt;
+    uint32_t switch_sel;
+    uint32_t done_delay;
+    uint32_t int_done_cnt;
+};
+
+class IO_CTRL {
+public:
+    IO_CTRL(uint16_t num_io) {
+        addr_gens = new Addr_gen[num_io];
+        this->num_io = num_io;
+        for (uint16_t i=0; i<num_io; i++) {
+            addr_gens[i].id = i;
+            addr_gens[i].mode = IDLE;
+            addr_gens[i].start_addr = 0;
+            addr_gens[i].int_addr = 0;
+            addr_gens[i].int_cnt = 0;
+            addr_gens[i].num_words = 0;
+            addr_gens[i].switch_sel = 0;
+            addr_gens[i].done_delay = 0;
+            addr_gens[i].int_done_cnt = 0;
+        }
+    }
+    ~IO_CTRL(void) {
+        delete[] addr_gens; 
+    }
+
+    uint16_t get_num_io() {
+        return this->num_io;
+    }
+    MODE get_mode(uint16_t num_io) {
+        return addr_gens[num_io].mode;
+    }
+    uint32_t get_start_addr(uint16_t num_io) {
+        return addr_gens[num_io].start_addr;
+    }
+    uint32_t get_int_addr(uint16_t num_io) {
+        return addr_gens[num_io].int_addr;
+    }
+    uint32_t get_num_words(uint16_t num_io) {
+        return addr_gens[num_io].num_words;
+    }
+    uint32_t get_int_cnt(uint16_t num_io) {
+        return addr_gens[num_io].int_cnt;
+    }
+    uint32_t get_done_delay(uint16_t num_io) {
+        return addr_gens[num_io].done_delay;
+    }
+    uint32_t get_int_done_cnt(uint16_t num_io) {
+        return addr_gens[num_io].int_done_cnt;
+    }
+    uint32_t get_switch_sel(uint16_t num_cfg) {
+        return addr_gens[num_cfg].switch_sel;
+    }
+    Addr_gen& get_addr_gen(uint16_t num_io) {
+        return addr_gens[num_io];
+    }
+
+    void set_mode(uint16_t num_io, MODE mode) {
+        addr_gens[num_io].mode = mode;
+    }
+    void set_start_addr(uint16_t num_io, uint32_t start_addr) {
+        if (start_addr % 2 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io].start_addr = start_addr;
+    }
+
+    void set_int_addr(uint16_t num_io, uint32_t int_addr) {
+        if (int_addr % 2 != 0) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Address is not word aligned" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io].int_addr = int_addr;
+    }
+    void set_int_done_cnt(uint16_t num_io, uint32_t int_done_cnt) {
+        addr_gens[num_io].int_done_cnt = int_done_cnt;
+    }
+
+
+    void set_num_words(uint16_t num_io, uint32_t num_words) {
+        addr_gens[num_io].num_words = num_words;
+    }
+
+    void set_int_cnt(uint16_t num_io, uint32_t int_cnt) {
+        addr_gens[num_io].int_cnt = int_cnt;
+    }
+    void set_switch_sel(uint16_t num_io, uint32_t switch_sel) {
+        if (switch_sel >= (1<<(NUM_BANKS/NUM_IO)) ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "IO controller " << num_io << "select switch cannot be configed to " << std::hex << "0x" << switch_sel <<  std::endl;
+            exit(EXIT_FAILURE);
+        }
+        addr_gens[num_io].switch_sel = switch_sel;
+    }
+    void set_done_delay(uint16_t num_io, uint32_t done_delay) {
+        addr_gens[num_io].done_delay = done_delay;
+    }
+
+private:
+    Addr_gen *addr_gens;
+    uint16_t num_io;
+};
+
+struct BANK_RD {
+    uint16_t bank;
+    uint32_t addr;
+};
+
+class IO_CTRL_TB : public TESTBENCH<Vio_controller> {
+public:
+    // bank reads in flight, by cycles until the data is returned
+    LATENCY_QUEUE<BANK_RD> bank_rd_queue;
+    // patterns of glc_to_io_stall and of each channel's cgra_to_io_wr_en in
+    // test(), see make_traffic_pattern(). Empty keeps the defaults.
+    std::string stall_spec;
+    std::string wr_en_spec;
+
+    IO_CTRL_TB(unsigned bank_rd_latency=1)
+        : bank_rd_queue(bank_rd_latency) {
+        m_dut->glc_to_io_stall = 0;
+        for (uint16_t i=0; i<sizeof(EVENT_NAMES)/sizeof(EVENT_NAMES[0]); i++)
+            tb_log.define_event(i, EVENT_NAMES[i]);
+        reset();
+    }
+
+    ~IO_CTRL_TB(void) {
+        delete m_model;
+    }
+
+    // Check every output of the DUT against IO_CTRL_MODEL from now on. The
+    // model starts out as after a reset, so enable it before reset().
+    void enable_model(void) {
+        delete m_model;
+        m_model = new IO_CTRL_MODEL(NUM_BANKS, NUM_IO, BANK_ADDR_WIDTH, BANK_DATA_WIDTH,
+                                    CGRA_DATA_WIDTH, GLB_ADDR_WIDTH,
+                                    CONFIG_FEATURE_WIDTH, CONFIG_REG_WIDTH);
+    }
+
+    void update() {
+        glb_update();
+        if (m_model) model_check();
+    }
+
+    void probe_ports(PORT_PROBE *recorder) {
+        recorder->probe("reset", &m_dut->reset, 1);
+        recorder->probe("cgra_start_pulse", &m_dut->cgra_start_pulse, 1);
+        recorder->probe("cgra_done_pulse", &m_dut->cgra_done_pulse, 1);
+        recorder->probe("glc_to_io_stall", &m_dut->glc_to_io_stall, 1);
+        recorder->probe("cgra_to_io_wr_en", m_dut->cgra_to_io_wr_en, NUM_IO, 1);
+        recorder->probe("cgra_to_io_rd_en", m_dut->cgra_to_io_rd_en, NUM_IO, 1);
+        recorder->probe("io_to_cgra_rd_data_valid", m_dut->io_to_cgra_rd_data_valid, NUM_IO, 1);
+        recorder->probe("cgra_to_io_wr_data", m_dut->cgra_to_io_wr_data, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("io_to_cgra_rd_data", m_dut->io_to_cgra_rd_data, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("cgra_to_io_addr_high", m_dut->cgra_to_io_addr_high, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("cgra_to_io_addr_low", m_dut->cgra_to_io_addr_low, NUM_IO, CGRA_DATA_WIDTH);
+        recorder->probe("io_to_bank_wr_en", m_dut->io_to_bank_wr_en, NUM_BANKS, 1);
+        recorder->probe("io_to_bank_wr_data", m_dut->io_to_bank_wr_data, NUM_BANKS, BANK_DATA_WIDTH);
+        recorder->probe("io_to_bank_wr_data_bit_sel", m_dut->io_to_bank_wr_data_bit_sel, NUM_BANKS, BANK_DATA_WIDTH);
+        recorder->probe("io_to_bank_wr_addr", m_dut->io_to_bank_wr_addr, NUM_BANKS, BANK_ADDR_WIDTH);
+        recorder->probe("io_to_bank_rd_en", m_dut->io_to_bank_rd_en, NUM_BANKS, 1);
+        recorder->probe("bank_to_io_rd_data", m_dut->bank_to_io_rd_data, NUM_BANKS, BANK_DATA_WIDTH);
+        recorder->probe("io_to_bank_rd_addr", m_dut->io_to_bank_rd_addr, NUM_BANKS, BANK_ADDR_WIDTH);
+        recorder->probe("config_en", &m_dut->config_en, 1);
+        recorder->probe("config_wr", &m_dut->config_wr, 1);
+        recorder->probe("config_rd", &m_dut->config_rd, 1);
+        recorder->probe("config_addr", &m_dut->config_addr, CONFIG_FEATURE_WIDTH+CONFIG_REG_WIDTH);
+        recorder->probe("config_wr_data", &m_dut->config_wr_data, 32);
+        recorder->probe("config_rd_data", &m_dut->config_rd_data, 32);
+    }
+
+    void config_wr(Addr_gen &addr_gen) {
+        uint16_t num_id = addr_gen.id;
+        config_wr(num_id, ID_MODE, addr_gen.mode);
+        config_wr(num_id, ID_START_ADDR, addr_gen.start_addr);
+        config_wr(num_id, ID_NUM_WORDS, addr_gen.num_words);
+        config_wr(num_id, ID_SWITCH_SEL, addr_gen.switch_sel);
+        config_wr(num_id, ID_DONE_DELAY, addr_gen.done_delay);
+    }
+
+    void config_wr(uint16_t num_ctrl, REG_ID reg_id, uint32_t data) {
+        TB_LOG(LOG_INFO, "Configuration for %d\n", num_ctrl);
+        if (num_ctrl > NUM_IO ) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Wrong number of io controller" << std::endl;
+            closetrace();
+            exit(EXIT_FAILURE);
+        }
+        uint32_t feature_id = num_ctrl;
+        uint32_t config_addr = (feature_id << CONFIG_REG_WIDTH) + reg_id;
+        uint32_t config_data = data;
+        m_dut->config_en = 1;
+        m_dut->config_wr = 1;
+        m_dut->config_addr = config_addr;
+        m_dut->config_wr_data = config_data;
+        tick();
+        m_dut->config_en = 0;
+        m_dut->config_wr = 0;
+        m_config_cycles++;
+    }
+
+    void config_rd(Addr_gen &addr_gen) {
+        uint16_t num_id = addr_gen.id;
+        config_rd(num_id, ID_MODE, addr_gen.mode);
+        config_rd(num_id, ID_START_ADDR, addr_gen.start_addr);
+        config_rd(num_id, ID_NUM_WORDS, addr_gen.num_words);
+        config_rd(num_id, ID_SWITCH_SEL, addr_gen.switch_sel);
+        config_rd(num_id, ID_DONE_DELAY, addr_gen.done_delay);
+    }
+    
+    // Register reads are combinational, so this takes a single cycle like
+    // a write and the next access follows right after
+    void config_rd(uint16_t num_ctrl, REG_ID reg_id, uint32_t data_expected) {
+        uint32_t feature_id = num_ctrl;
+        uint32_t config_addr = (feature_id << CONFIG_REG_WIDTH) + reg_id;
+        m_dut->config_en = 1;
+        m_dut->config_rd = 1;
+        m_dut->config_addr = config_addr;
+        m_config_cycles += read_at_latency(CONFIG_RD_LATENCY, [&]() {
+            my_assert(m_dut->config_rd_data, data_expected, "config_rd_data");
+        });
+        m_dut->config_en = 0;
+        m_dut->config_rd = 0;
+    }
+
+    void io_ctrl_setup(IO_CTRL* io_ctrl) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                TB_LOG(LOG_INFO, "Address generator %d : OUTSTREAM\n", i);
+                io_ctrl->set_int_addr(i, io_ctrl->get_start_addr(i));
+                io_ctrl->set_int_cnt(i, io_ctrl->get_num_words(i));
+            }
+            else if (io_ctrl->get_mode(i) == INSTREAM) {
+                TB_LOG(LOG_INFO, "Address generator %d : INSTREAM\n", i);
+                io_ctrl->set_int_addr(i, io_ctrl->get_start_addr(i));
+                io_ctrl->set_int_cnt(i, io_ctrl->get_num_words(i));
+            }
+            else if (io_ctrl->get_mode(i) == SRAM)
+                TB_LOG(LOG_INFO, "Address generator %d : SRAM\n", i);
+            else
+                TB_LOG(LOG_INFO, "Address generator %d : IDLE\n", i);
+        }
+    }
+    
+    void test(IO_CTRL* io_ctrl, uint32_t latency=10, uint32_t stall_cycle=0) {
+        // glb setting
+        for(uint16_t i=0; i<io_ctrl->get_num_io(); i++) {
+            config_wr(io_ctrl->get_addr_gen(i)); 
+        }
+
+        // why hurry?
+        tick(100);
+
+        uint32_t max_num_words = 0;
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) != IDLE) {
+                max_num_words = std::max(io_ctrl->get_num_words(i), max_num_words);
+            }
+        }
+        uint16_t* wr_data_array = new uint16_t[max_num_words];
+
+        // if stall_cycle is non-zero, randomly stall for stall_cycle cycles,
+        // unless stall_spec gives a pattern
+        std::string stall_default = "off";
+        if (stall_cycle != 0 && max_num_words > 0)
+            stall_default = "window:" + std::to_string(max((rand() % max_num_words)/2, (uint32_t)2))
+                            + ":" + std::to_string(stall_cycle);
+        unsigned seed = rand();
+        TRAFFIC_PATTERN *stall = make_traffic_pattern(stall_spec.empty() ? stall_default : stall_spec, seed);
+        std::vector<TRAFFIC_PATTERN*> wr_en(io_ctrl->get_num_io());
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            wr_en[i] = make_traffic_pattern(wr_en_spec.empty() ? "bernoulli:0.5" : wr_en_spec, seed + i + 1);
+
+        std::vector<CHANNEL_LOAD> load(io_ctrl->get_num_io(), CHANNEL_LOAD{0, 0});
+        auto account = [&]() {
+            for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+                if ((io_ctrl->get_mode(i) == INSTREAM || io_ctrl->get_mode(i) == OUTSTREAM)
+                        && io_ctrl->get_int_cnt(i) > 0) {
+                    load[i].busy_cycles++;
+                    load[i].stall_cycles += m_dut->glc_to_io_stall;
+                }
+            }
+        };
+
+        for (uint32_t i=0; i<max_num_words; i++)
+            wr_data_array[i] = (uint16_t)rand(); 
+
+        // toggle cgra_start_pulse
+        m_dut->cgra_start_pulse = 1;
+        tick();
+        m_dut->cgra_start_pulse = 0;
+
+        // internal counter and address set to num_words and start_address
+        io_ctrl_setup(io_ctrl);
+
+        // latency of read
+        tick();
+
+        // latency of application
+        for (uint32_t t=0; t<latency; t++) {
+            tick();
+            account();
+            instream(io_ctrl);
+        }
+
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                m_dut->cgra_to_io_wr_en[i] = 1;
+                m_dut->cgra_to_io_wr_data[i] = wr_data_array[0];
+            }
+        }
+
+        TB_LOG(LOG_INFO, "IO Controller starts\n");
+
+        uint32_t num_cnt = 0;
+        // traffic patterns may hold off most cycles, so allow plenty of
+        // cycles per word
+        uint32_t max_cycles = 100*max_num_words + stall_cycle + 1000;
+        m_dut->glc_to_io_stall = stall->next();
+        run_until([this]() { return m_dut->cgra_done_pulse == 1; }, max_cycles,
+                  [&]() {
+                      account();
+                      instream(io_ctrl);
+                      outstream(io_ctrl, wr_data_array, num_cnt, wr_en);
+                      m_dut->glc_to_io_stall = stall->next();
+                  }, "cgra_done_pulse");
+        m_dut->glc_to_io_stall = 0;
+        delete stall;
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            delete wr_en[i];
+
+        // check whether data is correctly written to glb
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                // address increase by 2 (byte addressable)
+                uint32_t start_addr = io_ctrl->get_start_addr(i);
+                uint32_t num_words = io_ctrl->get_num_words(i);
+                uint32_t j = glb->compare16(start_addr, wr_data_array, num_words);
+                if (j != num_words)
+                    my_assert(glb->read_bytes(start_addr + 2*j, 2), wr_data_array[j], "glb");
+            }
+        }
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++)
+            print_channel_throughput(i, io_ctrl->get_num_words(i), load[i]);
+
+        TB_LOG(LOG_INFO, "End feeding data\n");
+        
+        // why hurry?
+        tick(100);
+    }
+
+private:
+    IO_CTRL_MODEL *m_model = nullptr;
+
+    // Hand the inputs of this cycle to the model and compare what it
+    // predicts with the settled outputs of the DUT, then clock it. None of
+    // the outputs depends on bank_to_io_rd_data before the next edge, so
+    // the data glb_read() just returned does not need another eval().
+    void model_check(void) {
+        IO_CTRL_MODEL &m = *m_model;
+        m.reset = m_dut->reset;
+        m.cgra_start_pulse = m_dut->cgra_start_pulse;
+        m.glc_to_io_stall = m_dut->glc_to_io_stall;
+        for (uint16_t i=0; i<NUM_IO; i++) {
+            m.cgra_to_io_wr_en[i] = m_dut->cgra_to_io_wr_en[i];
+            m.cgra_to_io_rd_en[i] = m_dut->cgra_to_io_rd_en[i];
+            m.cgra_to_io_wr_data[i] = m_dut->cgra_to_io_wr_data[i];
+            m.cgra_to_io_addr_high[i] = m_dut->cgra_to_io_addr_high[i];
+            m.cgra_to_io_addr_low[i] = m_dut->cgra_to_io_addr_low[i];
+        }
+        for (uint16_t i=0; i<NUM_BANKS; i++)
+            m.bank_to_io_rd_data[i] = m_dut->bank_to_io_rd_data[i];
+        m.config_en = m_dut->config_en;
+        m.config_wr = m_dut->config_wr;
+        m.config_rd = m_dut->config_rd;
+        m.config_addr = m_dut->config_addr;
+        m.config_wr_data = m_dut->config_wr_data;
+        m.eval();
+
+        my_assert(m_dut->cgra_done_pulse, m.cgra_done_pulse, "cgra_done_pulse (model)");
+        my_assert(m_dut->config_rd_data, m.config_rd_data, "config_rd_data (model)");
+        for (uint16_t i=0; i<NUM_IO; i++) {
+            my_assert(m_dut->io_to_cgra_rd_data_valid[i], m.io_to_cgra_rd_data_valid[i], "io_to_cgra_rd_data_valid (model)");
+            my_assert(m_dut->io_to_cgra_rd_data[i], m.io_to_cgra_rd_data[i], "io_to_cgra_rd_data (model)");
+        }
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            my_assert(m_dut->io_to_bank_wr_en[i], m.io_to_bank_wr_en[i], "io_to_bank_wr_en (model)");
+            my_assert(m_dut->io_to_bank_rd_en[i], m.io_to_bank_rd_en[i], "io_to_bank_rd_en (model)");
+            my_assert(m_dut->io_to_bank_wr_addr[i], m.io_to_bank_wr_addr[i], "io_to_bank_wr_addr (model)");
+            my_assert(m_dut->io_to_bank_rd_addr[i], m.io_to_bank_rd_addr[i], "io_to_bank_rd_addr (model)");
+            my_assert_word(m_dut->io_to_bank_wr_data[i], m.io_to_bank_wr_data[i], "io_to_bank_wr_data (model)", CGRA_DATA_WIDTH);
+            my_assert_word(m_dut->io_to_bank_wr_data_bit_sel[i], m.io_to_bank_wr_data_bit_sel[i], "io_to_bank_wr_data_bit_sel (model)", CGRA_DATA_WIDTH);
+        }
+        m.clock();
+    }
+
+    void instream(IO_CTRL* io_ctrl) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == INSTREAM) {
+                uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                uint32_t int_addr = io_ctrl->get_int_addr(i);
+                if (int_cnt > 0) {
+                    if (m_dut->glc_to_io_stall == 0) {
+                        io_ctrl->set_int_addr(i, int_addr + 2);
+                        io_ctrl->set_int_cnt(i, int_cnt - 1);
+                    }
+                    else {
+                        int_addr = int_addr - 2;
+                    }
+                    TB_LOG(LOG_DEBUG, "Address generator number %d is streaming data to CGRA.\n", i);
+                    TB_LOG(LOG_DEBUG, "\tData: 0x%04x / Addr: 0x%08x / Valid: %01d\n", m_dut->io_to_cgra_rd_data[i], int_addr, m_dut->io_to_cgra_rd_data_valid[i]);
+                    log_event(EV_IO_RD, i, int_addr, m_dut->io_to_cgra_rd_data[i]);
+                    my_assert(m_dut->io_to_cgra_rd_data[i], glb->read_bytes(int_addr, 2), "io_to_cgra_rd_data");
+                    my_assert(m_dut->io_to_cgra_rd_data_valid[i], 1, "io_to_cgra_rd_data_valid");
+                }
+            }
+        }
+    }
+
+    void outstream(IO_CTRL* io_ctrl, uint16_t *data_array, uint32_t &num_cnt, std::vector<TRAFFIC_PATTERN*> &wr_en) {
+        for(uint16_t i=0; i < io_ctrl->get_num_io(); i++) {
+            if (io_ctrl->get_mode(i) == OUTSTREAM) {
+                bool next_wr_en = wr_en[i]->next();
+                uint32_t int_addr = io_ctrl->get_int_addr(i);
+                uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                TB_LOG(LOG_DEBUG, "CGRA is writing data to IO controller.\n");
+                TB_LOG(LOG_DEBUG, "\tData: 0x%04x / Addr: 0x%08x / Valid: %01d\n", m_dut->cgra_to_io_wr_data[i], int_addr, m_dut->cgra_to_io_wr_en[i]);
+                if (m_dut->glc_to_io_stall == 0) {
+                    if (m_dut->cgra_to_io_wr_en[i] == 1) {
+                        log_event(EV_IO_WR, i, int_addr, m_dut->cgra_to_io_wr_data[i]);
+                        io_ctrl->set_int_addr(i, int_addr + 2);
+                        io_ctrl->set_int_cnt(i, int_cnt - 1);
+                        m_dut->cgra_to_io_wr_data[i] = data_array[++num_cnt];
+                    }
+                    if (io_ctrl->get_int_cnt(i) == 0)
+                        m_dut->cgra_to_io_wr_en[i] = 0;
+                    else
+                        m_dut->cgra_to_io_wr_en[i] = next_wr_en;
+                }
+            }
+        }
+    }
+
+    void glb_update() {
+        glb_write();
+        glb_read();
+    }
+
+    void glb_read() {
+        bank_rd_queue.retire(m_tickcount, [this](const BANK_RD &rd) {
+            m_dut->bank_to_io_rd_data[rd.bank] = glb->read(rd.bank, rd.addr>>3);
+
+            TB_LOG(LOG_DEBUG, "Read data from bank %d\n", rd.bank);
+            TB_LOG(LOG_DEBUG, "\tData: 0x%016lx / Addr: 0x%08x\n", m_dut->bank_to_io_rd_data[rd.bank], rd.addr);
+            log_event(EV_BANK_RD, rd.bank, rd.addr, m_dut->bank_to_io_rd_data[rd.bank]);
+        });
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m_dut->io_to_bank_rd_en[i] == 1)
+                bank_rd_queue.push(m_tickcount, {i, m_dut->io_to_bank_rd_addr[i]});
+        }
+    }
+
+    void glb_write() {
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m_dut->io_to_bank_wr_en[i] == 1) {
+                glb->merge(i, m_dut->io_to_bank_wr_addr[i]>>3, m_dut->io_to_bank_wr_data[i], m_dut->io_to_bank_wr_data_bit_sel[i]);
+                TB_LOG(LOG_DEBUG, "Write data to bank %d\n", i);
+                TB_LOG(LOG_DEBUG, "\tData: 0x%016lx / Bit_sel: 0x%016lx, Addr: 0x%08x\n", m_dut->io_to_bank_wr_data[i], m_dut->io_to_bank_wr_data_bit_sel[i], m_dut->io_to_bank_wr_addr[i]);
+                log_event(EV_BANK_WR, i, m_dut->io_to_bank_wr_addr[i], m_dut->io_to_bank_wr_data[i]);
+            }
+        }
+    }
+};
+
+#endif
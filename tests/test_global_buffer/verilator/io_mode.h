@@ -0,0 +1,13 @@
+#ifndef IO_MODE_H
+#define IO_MODE_H
+
+// Modes of an io_controller channel, as programmed into its mode register
+typedef enum MODE
+{
+    IDLE        = 0,
+    INSTREAM    = 1,
+    OUTSTREAM   = 2,
+    SRAM        = 3
+} MODE;
+
+#endif
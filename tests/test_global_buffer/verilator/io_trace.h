@@ -0,0 +1,250 @@
+#ifndef IO_TRACE_H
+#define IO_TRACE_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+// Binary trace of the CGRA side inputs of the global buffer IO controllers,
+// cgra_to_io_* plus glc_to_io_stall and cgra_start_pulse, one record per
+// cycle. The file starts with an IO_TRACE_HEADER. A record is a tag byte,
+// either IO_TRACE_IDLE followed by a uint32_t count of cycles without stall
+// and without any enable, or IO_TRACE_STALL/IO_TRACE_START flags followed by
+// the wr_en and rd_en bit masks of all channels and then addr_high,
+// addr_low and, for writes, wr_data of every enabled channel as uint16_t.
+// Everything is host byte order.
+
+const uint16_t  IO_TRACE_MAX_IO = 32;
+const uint32_t  IO_TRACE_VERSION = 1;
+const char      IO_TRACE_MAGIC[8] = {'G', 'L', 'B', 'I', 'O', 'T', 'R', 'C'};
+
+typedef enum IO_TRACE_TAG {
+    IO_TRACE_STALL  = 1,
+    IO_TRACE_START  = 2,
+    IO_TRACE_IDLE   = 0x80
+} IO_TRACE_TAG;
+
+struct IO_TRACE_HEADER {
+    char        magic[8];
+    uint32_t    version;
+    uint16_t    num_io;
+    uint16_t    reserved;
+    uint64_t    cycles;
+};
+
+struct IO_TRACE_CYCLE {
+    bool        stall;
+    bool        start;
+    uint8_t     wr_en[IO_TRACE_MAX_IO];
+    uint8_t     rd_en[IO_TRACE_MAX_IO];
+    uint16_t    addr_high[IO_TRACE_MAX_IO];
+    uint16_t    addr_low[IO_TRACE_MAX_IO];
+    uint16_t    wr_data[IO_TRACE_MAX_IO];
+};
+
+class IO_TRACE_WRITER {
+public:
+    IO_TRACE_WRITER(const char *filename, uint16_t num_io) {
+        if (num_io > IO_TRACE_MAX_IO) {
+            std::cerr << "IO trace supports up to " << IO_TRACE_MAX_IO << " channels" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        m_file = fopen(filename, "wb");
+        if (m_file == NULL) {
+            std::cerr << "Cannot write IO trace " << filename << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        setvbuf(m_file, NULL, _IOFBF, 1 << 20);
+        memcpy(m_header.magic, IO_TRACE_MAGIC, sizeof(m_header.magic));
+        m_header.version = IO_TRACE_VERSION;
+        m_header.num_io = num_io;
+        m_header.reserved = 0;
+        m_header.cycles = 0;
+        m_idle = 0;
+        fwrite(&m_header, sizeof(m_header), 1, m_file);
+    }
+
+    ~IO_TRACE_WRITER(void) {
+        flush_idle();
+        fseek(m_file, 0, SEEK_SET);
+        fwrite(&m_header, sizeof(m_header), 1, m_file);
+        fclose(m_file);
+    }
+
+    unsigned long cycles(void) const {
+        return m_header.cycles;
+    }
+
+    // Sample the inputs of a model with the global buffer port names
+    template<class VMODULE>
+    void sample(const VMODULE *dut) {
+        IO_TRACE_CYCLE cycle;
+        cycle.stall = dut->glc_to_io_stall;
+        cycle.start = dut->cgra_start_pulse;
+        for (uint16_t i=0; i<m_header.num_io; i++) {
+            cycle.wr_en[i] = dut->cgra_to_io_wr_en[i];
+            cycle.rd_en[i] = dut->cgra_to_io_rd_en[i];
+            cycle.addr_high[i] = dut->cgra_to_io_addr_high[i];
+            cycle.addr_low[i] = dut->cgra_to_io_addr_low[i];
+            cycle.wr_data[i] = dut->cgra_to_io_wr_data[i];
+        }
+        write(cycle);
+    }
+
+    void write(const IO_TRACE_CYCLE &cycle) {
+        m_header.cycles++;
+        uint8_t tag = (cycle.stall ? IO_TRACE_STALL : 0) | (cycle.start ? IO_TRACE_START : 0);
+        uint8_t wr_mask[IO_TRACE_MAX_IO/8] = {0};
+        uint8_t rd_mask[IO_TRACE_MAX_IO/8] = {0};
+        bool enabled = false;
+        for (uint16_t i=0; i<m_header.num_io; i++) {
+            wr_mask[i/8] |= (cycle.wr_en[i] & 1) << (i%8);
+            rd_mask[i/8] |= (cycle.rd_en[i] & 1) << (i%8);
+            enabled |= cycle.wr_en[i] || cycle.rd_en[i];
+        }
+        if (tag == 0 && !enabled) {
+            if (++m_idle == UINT32_MAX)
+                flush_idle();
+            return;
+        }
+        flush_idle();
+        size_t mask_bytes = (m_header.num_io + 7) / 8;
+        fwrite(&tag, 1, 1, m_file);
+        fwrite(wr_mask, mask_bytes, 1, m_file);
+        fwrite(rd_mask, mask_bytes, 1, m_file);
+        for (uint16_t i=0; i<m_header.num_io; i++) {
+            if (!cycle.wr_en[i] && !cycle.rd_en[i])
+                continue;
+            fwrite(&cycle.addr_high[i], 2, 1, m_file);
+            fwrite(&cycle.addr_low[i], 2, 1, m_file);
+            if (cycle.wr_en[i])
+                fwrite(&cycle.wr_data[i], 2, 1, m_file);
+        }
+    }
+
+private:
+    FILE            *m_file;
+    IO_TRACE_HEADER m_header;
+    uint32_t        m_idle;
+
+    void flush_idle(void) {
+        if (m_idle == 0)
+            return;
+        uint8_t tag = IO_TRACE_IDLE;
+        fwrite(&tag, 1, 1, m_file);
+        fwrite(&m_idle, sizeof(m_idle), 1, m_file);
+        m_idle = 0;
+    }
+};
+
+// Reads a trace written by IO_TRACE_WRITER straight from a read-only
+// mapping of the file
+class IO_TRACE_READER {
+public:
+    IO_TRACE_READER(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IO_TRACE_HEADER))
+            error(filename, "cannot be read");
+        m_size = st.st_size;
+        void *data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            error(filename, "cannot be mapped");
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = (const uint8_t *)data;
+        memcpy(&m_header, m_data, sizeof(m_header));
+        if (memcmp(m_header.magic, IO_TRACE_MAGIC, sizeof(m_header.magic)) != 0
+                || m_header.version != IO_TRACE_VERSION || m_header.num_io > IO_TRACE_MAX_IO)
+            error(filename, "is not an IO trace");
+        m_filename = filename;
+        m_pos = sizeof(m_header);
+        m_idle = 0;
+    }
+
+    ~IO_TRACE_READER(void) {
+        munmap((void *)m_data, m_size);
+    }
+
+    uint16_t num_io(void) const {
+        return m_header.num_io;
+    }
+
+    unsigned long cycles(void) const {
+        return m_header.cycles;
+    }
+
+    // Decode the next cycle into cycle. Returns false at the end of the
+    // trace.
+    bool next(IO_TRACE_CYCLE &cycle) {
+        if (m_idle == 0 && m_pos < m_size && m_data[m_pos] == IO_TRACE_IDLE) {
+            read(&m_idle, 1, sizeof(m_idle));
+            clear(cycle);
+        }
+        if (m_idle > 0) {
+            m_idle--;
+            return true;
+        }
+        if (m_pos == m_size)
+            return false;
+
+        size_t mask_bytes = (m_header.num_io + 7) / 8;
+        if (m_pos + 1 + 2*mask_bytes > m_size)
+            error(m_filename.c_str(), "is truncated");
+        uint8_t tag = m_data[m_pos];
+        const uint8_t *wr_mask = m_data + m_pos + 1;
+        const uint8_t *rd_mask = wr_mask + mask_bytes;
+        m_pos += 1 + 2*mask_bytes;
+        cycle.stall = tag & IO_TRACE_STALL;
+        cycle.start = tag & IO_TRACE_START;
+        for (uint16_t i=0; i<m_header.num_io; i++) {
+            cycle.wr_en[i] = (wr_mask[i/8] >> (i%8)) & 1;
+            cycle.rd_en[i] = (rd_mask[i/8] >> (i%8)) & 1;
+            if (!cycle.wr_en[i] && !cycle.rd_en[i])
+                continue;
+            read(&cycle.addr_high[i], 0, 2);
+            read(&cycle.addr_low[i], 0, 2);
+            if (cycle.wr_en[i])
+                read(&cycle.wr_data[i], 0, 2);
+        }
+        return true;
+    }
+
+private:
+    const uint8_t   *m_data;
+    size_t          m_size;
+    size_t          m_pos;
+    IO_TRACE_HEADER m_header;
+    uint32_t        m_idle;
+    std::string     m_filename;
+
+    // copy size bytes at offset from the current position and move past them
+    void read(void *dst, size_t offset, size_t size) {
+        if (m_pos + offset + size > m_size)
+            error(m_filename.c_str(), "is truncated");
+        memcpy(dst, m_data + m_pos + offset, size);
+        m_pos += offset + size;
+    }
+
+    void clear(IO_TRACE_CYCLE &cycle) {
+        cycle.stall = false;
+        cycle.start = false;
+        memset(cycle.wr_en, 0, sizeof(cycle.wr_en));
+        memset(cycle.rd_en, 0, sizeof(cycle.rd_en));
+    }
+
+    void error(const char *filename, const char *what) {
+        std::cerr << std::endl;  // end the current line
+        std::cerr << "IO trace " << filename << " " << what << std::endl;
+        exit(EXIT_FAILURE);
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LATENCY_QUEUE_H
+#define LATENCY_QUEUE_H
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Scoreboard of in-flight requests which complete latency cycles after
+// they were issued. Requests are kept in issue order in a fixed-capacity
+// ring buffer, so with a fixed latency they are also due in order and
+// retire() only looks at the requests that are due.
+template<class T, unsigned CAPACITY=256> class LATENCY_QUEUE {
+public:
+    LATENCY_QUEUE(unsigned latency=1) {
+        m_latency = latency;
+        m_head = 0;
+        m_size = 0;
+    }
+
+    unsigned latency(void) const {
+        return m_latency;
+    }
+
+    // Only valid while nothing is in flight
+    void set_latency(unsigned latency) {
+        m_latency = latency;
+    }
+
+    bool empty(void) const {
+        return m_size == 0;
+    }
+
+    unsigned size(void) const {
+        return m_size;
+    }
+
+    void clear(void) {
+        m_head = 0;
+        m_size = 0;
+    }
+
+    // Issue req in cycle, it is due in cycle + latency
+    void push(uint64_t cycle, const T &req) {
+        if (m_size == CAPACITY) {
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "LATENCY_QUEUE overflow: more than " << CAPACITY
+                      << " requests in flight" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        ENTRY &entry = m_entries[(m_head + m_size) % CAPACITY];
+        entry.due = cycle + m_latency;
+        entry.req = req;
+        m_size++;
+    }
+
+    // Call complete(req) for every request due by cycle, oldest first, and
+    // remove them
+    template<class F>
+    void retire(uint64_t cycle, F complete) {
+        while (m_size > 0 && m_entries[m_head].due <= cycle) {
+            complete(m_entries[m_head].req);
+            m_head = (m_head + 1) % CAPACITY;
+            m_size--;
+        }
+    }
+
+    // Write the requests in flight to a checkpoint (see TESTBENCH::save()).
+    // T has to be plain data.
+    template<class OS>
+    void save(OS &os) const {
+        os.write(&m_latency, sizeof(m_latency));
+        os.write(&m_head, sizeof(m_head));
+        os.write(&m_size, sizeof(m_size));
+        os.write(m_entries, sizeof(m_entries));
+    }
+
+    template<class IS>
+    void restore(IS &is) {
+        is.read(&m_latency, sizeof(m_latency));
+        is.read(&m_head, sizeof(m_head));
+        is.read(&m_size, sizeof(m_size));
+        is.read(m_entries, sizeof(m_entries));
+    }
+
+private:
+    struct ENTRY {
+        uint64_t    due;
+        T           req;
+    };
+
+    ENTRY       m_entries[CAPACITY];
+    unsigned    m_latency;
+    unsigned    m_head;
+    unsigned    m_size;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "port_probe.h"
+
+// Ties the ports of a reference model to the ones of the DUT, two instances
+// of the same RTL clocked differently. Every cycle drive() hands the inputs
+// the harness set on the DUT to the reference model, and once both have
+// been clocked mismatch() finds the first port they disagree on.
+//
+// Ports are located by their offset from the root instance of the model,
+// which is where the ports of both instances live (see TB_ROOT).
+class LOCKSTEP : public PORT_PROBE {
+public:
+    LOCKSTEP(const void *dut_root, void *ref_root) {
+        m_dut_root = (const char *)dut_root;
+        m_ref_root = (char *)ref_root;
+    }
+
+    size_t num_probes(void) {
+        return m_ports.size();
+    }
+
+    // Copy every probed port of the DUT to the reference model. Outputs
+    // are copied as well, they matched after the last cycle and the
+    // reference model recomputes them anyway.
+    void drive(void) {
+        for (const auto &port : m_ports)
+            memcpy(m_ref_root + port.offset, m_dut_root + port.offset, port.size);
+    }
+
+    // Index of the first port the two models disagree on, -1 if none
+    int mismatch(void) {
+        for (size_t i=0; i<m_ports.size(); i++) {
+            if (dut_value(i) != ref_value(i))
+                return (int)i;
+        }
+        return -1;
+    }
+
+    const std::string &name(size_t i) {
+        return m_ports[i].name;
+    }
+
+    uint64_t dut_value(size_t i) {
+        return value(m_dut_root, m_ports[i]);
+    }
+
+    uint64_t ref_value(size_t i) {
+        return value(m_ref_root, m_ports[i]);
+    }
+
+protected:
+    void add(const std::string &name, const void *signal, size_t size, int width) {
+        PORT port;
+        port.name = name;
+        port.offset = (const char *)signal - m_dut_root;
+        port.size = size;
+        port.mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+        m_ports.push_back(port);
+    }
+
+private:
+    struct PORT {
+        std::string name;
+        ptrdiff_t   offset;
+        size_t      size;
+        uint64_t    mask;
+    };
+
+    const char          *m_dut_root;
+    char                *m_ref_root;
+    std::vector<PORT>   m_ports;
+
+    static uint64_t value(const char *root, const PORT &port) {
+        uint64_t value = 0;
+        memcpy(&value, root + port.offset, port.size);
+        return value & port.mask;
+    }
+};
+
+#endif
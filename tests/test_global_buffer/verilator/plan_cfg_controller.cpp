@@ -0,0 +1,290 @@
+/*==============================================================================
+** Module: plan_cfg_controller.cpp
+** Description: Plans how a bitstream is split over the config channels
+** NOTE:    Runs CFG_CTRL_MODEL (cfg_ctrl_model.h) alone, no Verilator model
+**          is needed:
+**              g++ -O2 -std=c++14 plan_cfg_controller.cpp
+**          The bitstream is --bitstream (see bitstream.h) or --words random
+**          entries. It is configured with 1, 2, 4 ... NUM_CFG channels, the
+**          words either split evenly over them (even) or filling the banks
+**          of one channel before the next (fill). Channels are spread out
+**          like in CFG_CTRL_TB::bitstream_test(). Every configuration write
+**          to the CGRA is checked against the bitstream; the cycles from
+**          config_start_pulse to config_done_pulse are printed per plan.
+**          The pass-through of global controller writes and reads to every
+**          channel is checked at the end.
+**============================================================================*/
+
+#include "bitstream.h"
+#include "cfg_ctrl_model.h"
+#include "latency_queue.h"
+#include "shadow_memory.h"
+#include <chrono>
+#include <random>
+#include <string>
+
+// Address is byte addressable
+uint16_t NUM_BANKS = 32;
+uint16_t NUM_CFG = 8;
+uint16_t BANK_ADDR_WIDTH = 17;
+uint16_t BANK_DATA_WIDTH = 64;
+uint16_t GLB_ADDR_WIDTH = 32;
+
+using namespace std;
+
+GLB_SHADOW *glb;
+
+struct BANK_RD {
+    uint16_t bank;
+    uint32_t addr;
+};
+
+typedef enum SPLIT {EVEN, FILL} SPLIT;
+
+struct PLAN_STATS {
+    uint16_t        channels;   // that got words
+    unsigned long   cycles;
+    double          seconds;
+};
+
+void plan_fail(const char *split, uint16_t num_channels, uint16_t channel, const string &what) {
+    cerr << endl;  // end the current line
+    cerr << split << " over " << dec << num_channels << " channels, channel " << channel
+         << ": " << what << endl;
+    exit(EXIT_FAILURE);
+}
+
+// Configures the CGRA with bitstream through model. The bank model answers
+// reads after one cycle like the one of CFG_CTRL_TB.
+class PLANNER {
+public:
+    CFG_CTRL_MODEL *model;
+    const vector<BITSTREAM_ENTRY> &bitstream;
+
+    PLANNER(CFG_CTRL_MODEL *model, const vector<BITSTREAM_ENTRY> &bitstream)
+        : model(model), bitstream(bitstream), m_bank_rd(1) {
+        m_cycle = 0;
+    }
+
+    static const char *split_name(SPLIT split) {
+        const char *names[] = {"even", "fill"};
+        return names[split];
+    }
+
+    // Words a channel holds: all of its banks
+    uint32_t capacity(void) const {
+        return model->banks_per_cfg() << (BANK_ADDR_WIDTH-3);
+    }
+
+    bool fits(uint16_t num_channels) const {
+        return bitstream.size() <= (size_t)num_channels * capacity();
+    }
+
+    PLAN_STATS run(SPLIT split, uint16_t num_channels) {
+        CFG_CTRL_MODEL &m = *model;
+        uint16_t bpc = m.banks_per_cfg();
+        uint16_t stride = NUM_CFG / num_channels;
+        size_t per_channel = split == EVEN ? (bitstream.size() + num_channels - 1) / num_channels
+                                           : capacity();
+        m_channels.assign(NUM_CFG, CHANNEL());
+        PLAN_STATS stats = {0, 0, 0};
+        for (uint16_t c=0; c<num_channels; c++) {
+            uint16_t id = c * stride;
+            CHANNEL &ch = m_channels[id];
+            ch.first = min(c * per_channel, bitstream.size());
+            ch.last = min(ch.first + per_channel, bitstream.size());
+            ch.next = ch.first;
+            uint32_t start_addr = (uint32_t)(id * bpc) << BANK_ADDR_WIDTH;
+            for (size_t w=ch.first; w<ch.last; w++)
+                glb->write_word(start_addr + 8*(w - ch.first), bitstream_word(bitstream[w]));
+            // channels left without words are switched off, they repeat the
+            // one before them
+            if (ch.last > ch.first)
+                stats.channels++;
+            m.configure(id, start_addr, ch.last - ch.first, ch.last > ch.first ? (1 << bpc) - 1 : 0);
+        }
+        for (uint16_t j=0; j<NUM_CFG; j++) {
+            if (m_channels[j].last == m_channels[j].first)
+                m.configure(j, 0, 0, 0);
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        unsigned long start = m_cycle;
+        m.config_start_pulse = 1;
+        cycle(split, num_channels);
+        m.config_start_pulse = 0;
+        unsigned long max_cycles = per_channel + 100;
+        while (!m.config_done_pulse) {
+            if (m_cycle - start > max_cycles)
+                plan_fail(split_name(split), num_channels, 0, "no config_done_pulse");
+            cycle(split, num_channels);
+        }
+        stats.cycles = m_cycle - start;
+        // a channel writes its last word the cycle before its done pulse,
+        // so nothing is left in flight
+        for (uint16_t j=0; j<NUM_CFG; j++) {
+            CHANNEL &ch = m_channels[j];
+            if (ch.next != ch.last)
+                plan_fail(split_name(split), num_channels, j,
+                          to_string(ch.next - ch.first) + " words instead of " + to_string(ch.last - ch.first));
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+        stats.seconds = elapsed.count();
+        return stats;
+    }
+
+    // A global controller write then read, to every channel at once
+    void jtag(uint32_t addr, uint32_t data) {
+        CFG_CTRL_MODEL &m = *model;
+        for (int read=0; read<2; read++) {
+            m.glc_to_cgra_cfg_addr = addr;
+            m.glc_to_cgra_cfg_data = data;
+            m.glc_to_cgra_cfg_wr = !read;
+            m.glc_to_cgra_cfg_rd = read;
+            m.eval();
+            for (uint16_t j=0; j<NUM_CFG; j++) {
+                if (m.glb_to_cgra_cfg_wr[j] != !read || m.glb_to_cgra_cfg_rd[j] != read
+                        || m.glb_to_cgra_cfg_addr[j] != addr || m.glb_to_cgra_cfg_data[j] != data)
+                    plan_fail("jtag", NUM_CFG, j, read ? "read not passed through" : "write not passed through");
+            }
+            m.clock();
+        }
+        m.glc_to_cgra_cfg_wr = 0;
+        m.glc_to_cgra_cfg_rd = 0;
+        m.eval();
+        for (uint16_t j=0; j<NUM_CFG; j++) {
+            if (m.glb_to_cgra_cfg_wr[j] || m.glb_to_cgra_cfg_rd[j])
+                plan_fail("jtag", NUM_CFG, j, "access not released");
+        }
+    }
+
+private:
+    struct CHANNEL {
+        size_t  first;      // bitstream entries it writes
+        size_t  last;
+        size_t  next;       // next entry to write
+
+        CHANNEL() : first(0), last(0), next(0) {}
+    };
+
+    vector<CHANNEL>         m_channels;
+    LATENCY_QUEUE<BANK_RD>  m_bank_rd;
+    unsigned long           m_cycle;
+
+    void cycle(SPLIT split, uint16_t num_channels) {
+        CFG_CTRL_MODEL &m = *model;
+        m.eval();
+        for (uint16_t j=0; j<NUM_CFG; j++)
+            check(split, num_channels, j);
+        m_bank_rd.retire(m_cycle, [&m](const BANK_RD &rd) {
+            m.bank_to_cfg_rd_data[rd.bank] = glb->read(rd.bank, rd.addr>>3);
+        });
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m.cfg_to_bank_rd_en[i])
+                m_bank_rd.push(m_cycle, {i, m.cfg_to_bank_rd_addr[i]});
+        }
+        m.clock();
+        m_cycle++;
+    }
+
+    // What channel j writes to the CGRA this cycle. Switched off channels
+    // repeat the writes of the one before them, they are not counted.
+    void check(SPLIT split, uint16_t num_channels, uint16_t j) {
+        CFG_CTRL_MODEL &m = *model;
+        CHANNEL &ch = m_channels[j];
+        if (!m.glb_to_cgra_cfg_wr[j] || ch.last == ch.first)
+            return;
+        if (ch.next == ch.last)
+            plan_fail(split_name(split), num_channels, j, "write after the last word");
+        const BITSTREAM_ENTRY &entry = bitstream[ch.next];
+        if (m.glb_to_cgra_cfg_addr[j] != entry.addr || m.glb_to_cgra_cfg_data[j] != entry.data)
+            plan_fail(split_name(split), num_channels, j, "word " + to_string(ch.next - ch.first) + " wrong");
+        ch.next++;
+    }
+};
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    string bitstream_file;
+    unsigned seed = 0;
+    unsigned num_words = 100000;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "--bitstream") {
+            bitstream_file = argv[i+1];
+        }
+        else if (argv_tmp == "--words") {
+            num_words = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--seed") {
+            seed = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            GLB_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    vector<BITSTREAM_ENTRY> bitstream;
+    if (!bitstream_file.empty()) {
+        if (!load_bitstream(bitstream_file.c_str(), bitstream)) {
+            cerr << "Cannot read bitstream " << bitstream_file << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else {
+        mt19937 rng(seed);
+        bitstream.resize(num_words);
+        for (BITSTREAM_ENTRY &entry : bitstream)
+            entry = {(uint32_t)rng(), (uint32_t)rng()};
+    }
+    if (bitstream.empty()) {
+        cerr << "Bitstream is empty, there is nothing to plan" << endl;
+        return EXIT_FAILURE;
+    }
+    printf("Bitstream: %lu words\n", (unsigned long)bitstream.size());
+
+    glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH);
+    CFG_CTRL_MODEL *model = new CFG_CTRL_MODEL(NUM_BANKS, NUM_CFG, BANK_ADDR_WIDTH, BANK_DATA_WIDTH,
+                                               GLB_ADDR_WIDTH);
+    model->reset = 1;
+    model->eval();
+    model->clock();
+    model->reset = 0;
+
+    PLANNER planner(model, bitstream);
+    const SPLIT splits[] = {EVEN, FILL};
+    bool planned = false;
+    for (SPLIT split : splits) {
+        for (uint16_t n=1; n<=NUM_CFG; n*=2) {
+            if (!planner.fits(n))
+                continue;
+            PLAN_STATS stats = planner.run(split, n);
+            planned = true;
+            printf("%-4s over %2u channels: %2u used, %8lu cycles (%.2f words/cycle) in %.3f s\n",
+                   PLANNER::split_name(split), n, stats.channels, stats.cycles,
+                   (double)bitstream.size() / stats.cycles, stats.seconds);
+        }
+    }
+    if (!planned) {
+        cerr << "Bitstream of " << bitstream.size() << " words does not fit in "
+             << NUM_CFG << " channels" << endl;
+        return EXIT_FAILURE;
+    }
+    planner.jtag(0xDEADBEEF, 0x12345678);
+
+    printf("\nAll plans are passed!\n");
+    delete model;
+    delete glb;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,31 @@
+#ifndef PORT_PROBE_H
+#define PORT_PROBE_H
+
+#include <stdint.h>
+#include <string>
+
+// Something derived testbenches list their DUT ports to, see
+// TESTBENCH::probe_ports(). The flight recorder samples them, the lockstep
+// check copies and compares them.
+class PORT_PROBE {
+public:
+    virtual ~PORT_PROBE(void) {}
+
+    template<class T>
+    void probe(const std::string &name, const T *signal, int width=8*sizeof(T)) {
+        static_assert(sizeof(T) <= sizeof(uint64_t), "signal wider than 64 bits");
+        add(name, signal, sizeof(T), width);
+    }
+
+    // Probe every element of an unpacked array port
+    template<class T>
+    void probe(const std::string &name, const T *signal, size_t num, int width) {
+        for (size_t i=0; i<num; i++)
+            probe(name + "(" + std::to_string(i) + ")", &signal[i], width);
+    }
+
+protected:
+    virtual void add(const std::string &name, const void *signal, size_t size, int width) = 0;
+};
+
+#endif
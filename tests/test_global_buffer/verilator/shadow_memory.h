@@ -0,0 +1,229 @@
+#ifndef SHADOW_MEMORY_H
+#define SHADOW_MEMORY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// Golden model of the GLB banks. Memory is split into pages which are only
+// allocated on the first write, so the footprint follows the data a test
+// touches instead of NUM_BANKS << BANK_ADDR_WIDTH. Entries that were never
+// written read as fill(bank, index), or 0 without a fill function.
+template<class T> class SHADOW_MEMORY {
+public:
+    typedef std::function<T(uint32_t bank, uint32_t index)> fill_t;
+
+    SHADOW_MEMORY(uint32_t num_banks, uint32_t bank_size, fill_t fill=nullptr,
+                  uint32_t page_bits=10) {
+        m_num_banks = num_banks;
+        m_bank_size = bank_size;
+        m_page_bits = page_bits;
+        m_page_size = 1 << page_bits;
+        m_num_pages = 0;
+        m_fill = fill;
+        uint32_t pages_per_bank = (bank_size + m_page_size - 1) >> page_bits;
+        m_pages.assign(num_banks, std::vector<T*>(pages_per_bank, NULL));
+    }
+
+    ~SHADOW_MEMORY(void) {
+        for (auto &bank : m_pages)
+            for (T *page : bank)
+                delete[] page;
+    }
+
+    T read(uint32_t bank, uint32_t index) const {
+        const T *page = m_pages[bank][index >> m_page_bits];
+        if (page)
+            return page[index & (m_page_size-1)];
+        return m_fill ? m_fill(bank, index) : 0;
+    }
+
+    void write(uint32_t bank, uint32_t index, T value) {
+        (*this)(bank, index) = value;
+    }
+
+    // Only the bits set in mask are written
+    void merge(uint32_t bank, uint32_t index, T value, T mask) {
+        T &entry = (*this)(bank, index);
+        entry = (entry & ~mask) | (value & mask);
+    }
+
+    // Reference to an entry, allocating its page if needed
+    T &operator()(uint32_t bank, uint32_t index) {
+        T *&page = m_pages[bank][index >> m_page_bits];
+        if (!page)
+            page = alloc_page(bank, index >> m_page_bits);
+        return page[index & (m_page_size-1)];
+    }
+
+    uint32_t num_banks(void) const {
+        return m_num_banks;
+    }
+
+    uint32_t bank_size(void) const {
+        return m_bank_size;
+    }
+
+    // Number of allocated pages and the bytes they hold
+    unsigned long num_pages(void) const {
+        return m_num_pages;
+    }
+
+    unsigned long bytes(void) const {
+        return m_num_pages * m_page_size * sizeof(T);
+    }
+
+    // Write the allocated pages to a checkpoint (see TESTBENCH::save()),
+    // the others still read as fill() after restore()
+    template<class OS>
+    void save(OS &os) const {
+        os.write(&m_num_banks, sizeof(m_num_banks));
+        os.write(&m_bank_size, sizeof(m_bank_size));
+        os.write(&m_page_bits, sizeof(m_page_bits));
+        os.write(&m_num_pages, sizeof(m_num_pages));
+        for (uint32_t bank=0; bank<m_num_banks; bank++) {
+            for (uint32_t page_num=0; page_num<m_pages[bank].size(); page_num++) {
+                const T *page = m_pages[bank][page_num];
+                if (!page)
+                    continue;
+                os.write(&bank, sizeof(bank));
+                os.write(&page_num, sizeof(page_num));
+                os.write(page, m_page_size * sizeof(T));
+            }
+        }
+    }
+
+    // Replace the content with the one of a checkpoint. Returns false if it
+    // was saved from a memory of a different size.
+    template<class IS>
+    bool restore(IS &is) {
+        uint32_t num_banks, bank_size, page_bits;
+        is.read(&num_banks, sizeof(num_banks));
+        is.read(&bank_size, sizeof(bank_size));
+        is.read(&page_bits, sizeof(page_bits));
+        if (num_banks != m_num_banks || bank_size != m_bank_size || page_bits != m_page_bits)
+            return false;
+        for (auto &bank : m_pages) {
+            for (T *&page : bank) {
+                delete[] page;
+                page = NULL;
+            }
+        }
+        unsigned long num_pages;
+        is.read(&num_pages, sizeof(num_pages));
+        for (unsigned long n=0; n<num_pages; n++) {
+            uint32_t bank, page_num;
+            is.read(&bank, sizeof(bank));
+            is.read(&page_num, sizeof(page_num));
+            T *page = new T[m_page_size];
+            is.read(page, m_page_size * sizeof(T));
+            m_pages[bank][page_num] = page;
+        }
+        m_num_pages = num_pages;
+        return true;
+    }
+
+private:
+    uint32_t    m_num_banks;
+    uint32_t    m_bank_size;
+    uint32_t    m_page_bits;
+    uint32_t    m_page_size;
+    unsigned long m_num_pages;
+    fill_t      m_fill;
+    std::vector<std::vector<T*> > m_pages;
+
+    T *alloc_page(uint32_t bank, uint32_t page_num) {
+        T *page = new T[m_page_size];
+        uint32_t base = page_num << m_page_bits;
+        for (uint32_t i=0; i<m_page_size; i++)
+            page[i] = m_fill ? m_fill(bank, base + i) : 0;
+        m_num_pages++;
+        return page;
+    }
+};
+
+// The GLB shadow as native 64bit bank words, addressed with the byte
+// addresses the DUT uses (bank = addr >> bank_addr_width). Partial writes
+// are masked merges into the word and checks compare whole words.
+class GLB_SHADOW : public SHADOW_MEMORY<uint64_t> {
+public:
+    GLB_SHADOW(uint32_t num_banks, uint32_t bank_addr_width, fill_t fill=nullptr)
+        : SHADOW_MEMORY<uint64_t>(num_banks, 1 << (bank_addr_width-3), fill) {
+        m_bank_addr_width = bank_addr_width;
+    }
+
+    uint32_t bank(uint32_t addr) const {
+        return addr >> m_bank_addr_width;
+    }
+
+    uint32_t index(uint32_t addr) const {
+        return (addr & ((1 << m_bank_addr_width) - 1)) >> 3;
+    }
+
+    // Bits of the word covered by the bytes bytes at addr
+    static uint64_t byte_mask(uint32_t addr, uint32_t bytes) {
+        uint64_t mask = (bytes >= 8) ? ~0ULL : ((1ULL << (8*bytes)) - 1);
+        return mask << (8*(addr & 0b111));
+    }
+
+    // Expand a byte write strobe to a bit mask
+    static uint64_t strb_mask(uint32_t strb) {
+        uint64_t mask = 0;
+        for (int i=0; i<8; i++) {
+            if ((strb >> i) & 1)
+                mask |= 0xFFULL << (8*i);
+        }
+        return mask;
+    }
+
+    uint64_t read_word(uint32_t addr) const {
+        return read(bank(addr), index(addr));
+    }
+
+    void write_word(uint32_t addr, uint64_t data, uint64_t mask=~0ULL) {
+        merge(bank(addr), index(addr), data, mask);
+    }
+
+    // bytes wide value at addr, e.g. a 16bit CGRA word or a 32bit config word
+    uint64_t read_bytes(uint32_t addr, uint32_t bytes) const {
+        return (read_word(addr) & byte_mask(addr, bytes)) >> (8*(addr & 0b111));
+    }
+
+    void write_bytes(uint32_t addr, uint32_t bytes, uint64_t data) {
+        write_word(addr, data << (8*(addr & 0b111)), byte_mask(addr, bytes));
+    }
+
+    // Compare num consecutive 16bit words starting at addr against expected,
+    // a full bank word at a time. Returns the first mismatching word or num.
+    size_t compare16(uint32_t addr, const uint16_t *expected, size_t num) const {
+        size_t n = 0;
+        while (n < num) {
+            uint32_t word_addr = addr + 2*n;
+            uint32_t lane = (word_addr & 0b111) >> 1;
+            size_t cnt = 4 - lane;
+            if (cnt > num - n)
+                cnt = num - n;
+            uint64_t data = 0;
+            uint64_t mask = 0;
+            for (size_t k=0; k<cnt; k++) {
+                data |= (uint64_t)expected[n+k] << (16*(lane+k));
+                mask |= 0xFFFFULL << (16*(lane+k));
+            }
+            uint64_t diff = (read_word(word_addr) ^ data) & mask;
+            if (diff != 0) {
+                for (size_t k=0; k<cnt; k++) {
+                    if ((diff >> (16*(lane+k))) & 0xFFFF)
+                        return n + k;
+                }
+            }
+            n += cnt;
+        }
+        return num;
+    }
+
+private:
+    uint32_t    m_bank_addr_width;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef SPEED_BENCH_H
+#define SPEED_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Simulator throughput benchmark shared by the speed_*.cpp drivers. Every
+// workload is a fixed, deterministic stimulus which runs on a fresh model
+// with tracing off and on and with golden model checks off and on, reps
+// times each. Results are simulated cycles per wall-clock second with their
+// spread over the repetitions, so that a change of the Verilator flags, the
+// RTL or the harness shows up as a difference between two runs.
+
+// Options of the speed drivers, passed as "--name value" like TB_ARGS
+struct SPEED_OPTIONS {
+    unsigned        reps;
+    unsigned long   cycles;     // simulated cycles per workload and run
+    std::string     workload;   // only run this one, all if empty
+    std::string     json;
+
+    SPEED_OPTIONS(void) {
+        reps = 5;
+        cycles = 1000000;
+        workload = "";
+        json = "";
+    }
+
+    // returns false if key is not a speed option
+    bool parse(const std::string &key, const char *value) {
+        if (key == "--reps")
+            reps = std::max(std::stoi(value), 1);
+        else if (key == "--cycles")
+            cycles = std::stoul(value);
+        else if (key == "--workload")
+            workload = value;
+        else if (key == "--json")
+            json = value;
+        else
+            return false;
+        return true;
+    }
+};
+
+struct SPEED_SAMPLE {
+    unsigned long   cycles;
+    double          seconds;
+};
+
+// Cycles simulated by body and the wall-clock time it took. Building the
+// model and loading its memories stays outside of the measurement.
+template<class TB>
+SPEED_SAMPLE time_run(TB *tb, std::function<void(void)> body) {
+    unsigned long start = tb->tickcount();
+    auto t0 = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+    return {tb->tickcount() - start, elapsed.count()};
+}
+
+// Different data for every address
+inline uint64_t speed_data(uint32_t addr) {
+    return (addr + 1) * 0x9E3779B97F4A7C15ULL;
+}
+
+struct SPEED_RESULT {
+    std::string             workload;
+    bool                    trace;
+    bool                    check;
+    unsigned long           cycles;     // of the first repetition
+    std::vector<double>     rates;      // cycles/s of every repetition
+};
+
+class SPEED_BENCH {
+public:
+    // A run of a workload on a fresh model, with a trace open or not and
+    // checks on or off
+    typedef std::function<SPEED_SAMPLE(bool trace, bool check)> run_t;
+
+    // traced runs are skipped unless trace. clock is the clocking scheme
+    // of the testbench (--clock), only reported.
+    SPEED_BENCH(const char *dut, const SPEED_OPTIONS &options, bool trace,
+                const std::string &clock="full") {
+        m_dut = dut;
+        m_options = options;
+        m_trace = trace;
+        m_clock = clock;
+        printf("Clock: %s\n", m_clock.c_str());
+        printf("%-12s %-5s %-5s %10s %12s %7s %12s %12s %12s\n", "workload", "trace", "check",
+               "cycles", "mean c/s", "stddev", "min c/s", "median c/s", "max c/s");
+    }
+
+    void run(const char *workload, run_t run) {
+        if (!m_options.workload.empty() && m_options.workload != workload)
+            return;
+        for (int trace=0; trace<=(int)m_trace; trace++) {
+            for (int check=0; check<=1; check++) {
+                SPEED_RESULT result = {workload, trace != 0, check != 0, 0, {}};
+                for (unsigned r=0; r<m_options.reps; r++) {
+                    SPEED_SAMPLE sample = run(trace != 0, check != 0);
+                    if (r == 0)
+                        result.cycles = sample.cycles;
+                    result.rates.push_back(sample.cycles / sample.seconds);
+                }
+                print(result);
+                m_results.push_back(result);
+            }
+        }
+    }
+
+    bool write_json(const char *filename) const {
+        FILE *f = fopen(filename, "w");
+        if (f == NULL)
+            return false;
+        fprintf(f, "{\n  \"dut\": \"%s\",\n  \"clock\": \"%s\",\n  \"reps\": %u,\n  \"results\": [",
+                m_dut, m_clock.c_str(), m_options.reps);
+        for (size_t i=0; i<m_results.size(); i++) {
+            const SPEED_RESULT &result = m_results[i];
+            STATS s = stats(result.rates);
+            fprintf(f, "%s\n    {\"workload\": \"%s\", \"trace\": %s, \"check\": %s, \"cycles\": %lu, "
+                       "\"mean\": %.1f, \"stddev\": %.1f, \"min\": %.1f, \"median\": %.1f, \"max\": %.1f, \"rates\": [",
+                    i ? "," : "", result.workload.c_str(), result.trace ? "true" : "false",
+                    result.check ? "true" : "false", result.cycles,
+                    s.mean, s.stddev, s.min, s.median, s.max);
+            for (size_t r=0; r<result.rates.size(); r++)
+                fprintf(f, "%s%.1f", r ? ", " : "", result.rates[r]);
+            fprintf(f, "]}");
+        }
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+        return true;
+    }
+
+private:
+    struct STATS {
+        double  mean;
+        double  stddev;     // sample standard deviation
+        double  min;
+        double  median;
+        double  max;
+    };
+
+    const char                  *m_dut;
+    SPEED_OPTIONS               m_options;
+    bool                        m_trace;
+    std::string                 m_clock;
+    std::vector<SPEED_RESULT>   m_results;
+
+    static STATS stats(std::vector<double> rates) {
+        STATS s;
+        std::sort(rates.begin(), rates.end());
+        size_t n = rates.size();
+        double sum = 0, sum_sq = 0;
+        for (double rate : rates)
+            sum += rate;
+        s.mean = sum / n;
+        for (double rate : rates)
+            sum_sq += (rate - s.mean) * (rate - s.mean);
+        s.stddev = n > 1 ? std::sqrt(sum_sq / (n - 1)) : 0;
+        s.min = rates.front();
+        s.max = rates.back();
+        s.median = n % 2 ? rates[n/2] : (rates[n/2 - 1] + rates[n/2]) / 2;
+        return s;
+    }
+
+    void print(const SPEED_RESULT &result) const {
+        STATS s = stats(result.rates);
+        printf("%-12s %-5s %-5s %10lu %12.0f %6.1f%% %12.0f %12.0f %12.0f\n",
+               result.workload.c_str(), result.trace ? "on" : "off", result.check ? "on" : "off",
+               result.cycles, s.mean, 100 * s.stddev / s.mean, s.min, s.median, s.max);
+    }
+};
+
+#endif
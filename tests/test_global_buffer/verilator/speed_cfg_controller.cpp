@@ -0,0 +1,160 @@
+/*==============================================================================
+** Module: speed_cfg_controller.cpp
+** Description: Simulator throughput benchmark for configuration controller
+** NOTE:    Fixed workloads of --cycles cycles each (default 1M), every one
+**          with tracing off and on and with checks off and on, --reps
+**          times (see speed_bench.h):
+**          stream - config streams of --stream-words words on all
+**                   channels, over and over
+**          jtag   - a JTAG write through to every channel each cycle
+**          The bank model of CFG_CTRL_TB runs either way, the DUT needs its
+**          read data. Results are printed in cycles/s and written as JSON
+**          with --json <file>.
+**============================================================================*/
+
+#include "cfg_ctrl_tb.h"
+#include "speed_bench.h"
+
+// Words per stream (--stream-words)
+unsigned long STREAM_WORDS = 4096;
+
+// As CFG_CTRL_TB::test(), every channel streams a word every cycle
+void cfg_stream(CFG_CTRL_TB *tb, CFG_CTRL *cfg_ctrl) {
+    Vcfg_controller *dut = tb->m_dut;
+    dut->config_start_pulse = 1;
+    tb->tick();
+    dut->config_start_pulse = 0;
+    tb->cfg_ctrl_setup(cfg_ctrl);
+    tb->tick();
+    tb->run_until([dut]() { return dut->config_done_pulse == 1; }, STREAM_WORDS + 100,
+                  [&]() {
+                      if (!tb->checking())
+                          return;
+                      for (uint16_t i=0; i<NUM_CFG; i++) {
+                          uint32_t int_cnt = cfg_ctrl->get_int_cnt(i);
+                          uint32_t int_addr = cfg_ctrl->get_int_addr(i);
+                          if (int_cnt == 0)
+                              continue;
+                          tb->my_assert_word(((uint64_t)dut->glb_to_cgra_cfg_addr[i] << 32) | dut->glb_to_cgra_cfg_data[i],
+                                             glb->read_word(int_addr), "glb_to_cgra_cfg", 32);
+                          tb->my_assert(dut->glb_to_cgra_cfg_wr[i], 1, "glb_to_cgra_cfg_wr");
+                          cfg_ctrl->set_int_addr(i, int_addr + 8);
+                          cfg_ctrl->set_int_cnt(i, int_cnt - 1);
+                      }
+                  }, "config_done_pulse");
+}
+
+// As CFG_CTRL_TB::jtag_test() back to back
+void jtag_stream(CFG_CTRL_TB *tb, unsigned long cycles) {
+    Vcfg_controller *dut = tb->m_dut;
+    dut->glc_to_cgra_cfg_wr = 1;
+    for (unsigned long t=0; t<cycles; t++) {
+        uint64_t word = speed_data(t);
+        dut->glc_to_cgra_cfg_addr = (uint32_t)(word >> 32);
+        dut->glc_to_cgra_cfg_data = (uint32_t)word;
+        tb->tick();
+        if (!tb->checking())
+            continue;
+        for (uint16_t i=0; i<NUM_CFG; i++) {
+            tb->my_assert(dut->glb_to_cgra_cfg_addr[i], (uint32_t)(word >> 32), "glb_to_cgra_cfg_addr");
+            tb->my_assert(dut->glb_to_cgra_cfg_data[i], (uint32_t)word, "glb_to_cgra_cfg_data");
+            tb->my_assert(dut->glb_to_cgra_cfg_wr[i], 1, "glb_to_cgra_cfg_wr");
+        }
+    }
+    dut->glc_to_cgra_cfg_wr = 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    TB_ARGS tb_args;
+    SPEED_OPTIONS options;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_DATA_WIDTH") {
+            BANK_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            // only sizes the RTL
+        }
+        else if (argv_tmp == "CGRA_DATA_WIDTH") {
+            CGRA_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CONFIG_FEATURE_WIDTH") {
+            CONFIG_FEATURE_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CONFIG_REG_WIDTH") {
+            CONFIG_REG_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--stream-words") {
+            STREAM_WORDS = stoul(argv[i+1], &pos);
+        }
+        else if (!options.parse(argv_tmp, argv[i+1]) && !tb_args.parse(argv_tmp, argv[i+1])) {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A fresh model and shadow for every run, so that every repetition
+    // simulates exactly the same cycles. Untouched words read as
+    // speed_data() of their address.
+    CFG_CTRL_TB *cfg_ctrl_tb = NULL;
+    auto open = [&](bool trace, bool check) {
+        glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH,
+                [](uint32_t bank, uint32_t index) {
+                    return speed_data((bank << BANK_ADDR_WIDTH) + 8*index);
+                });
+        cfg_ctrl_tb = new CFG_CTRL_TB();
+        cfg_ctrl_tb->trace_options(tb_args);
+        cfg_ctrl_tb->log_options(tb_args);
+        cfg_ctrl_tb->perf_options(tb_args);
+        cfg_ctrl_tb->checking(check);
+        if (trace)
+            cfg_ctrl_tb->opentrace("trace_speed_cfg_ctrl.vcd");
+    };
+    auto close = [&]() {
+        delete cfg_ctrl_tb;
+        delete glb;
+    };
+
+    SPEED_BENCH bench("cfg_controller", options, tb_args.trace, tb_args.clock);
+    bench.run("stream", [&](bool trace, bool check) {
+        open(trace, check);
+        uint16_t banks_per_cfg = NUM_BANKS / NUM_CFG;
+        CFG_CTRL *cfg_ctrl = new CFG_CTRL(NUM_CFG);
+        for (uint16_t i=0; i<NUM_CFG; i++) {
+            cfg_ctrl->set_start_addr(i, (i * banks_per_cfg) << BANK_ADDR_WIDTH);
+            cfg_ctrl->set_num_words(i, STREAM_WORDS);
+            cfg_ctrl->set_switch_sel(i, (1 << banks_per_cfg) - 1);
+            cfg_ctrl_tb->config_wr(cfg_ctrl->get_addr_gen(i));
+        }
+        unsigned long end = cfg_ctrl_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(cfg_ctrl_tb, [&]() {
+            while (cfg_ctrl_tb->tickcount() < end)
+                cfg_stream(cfg_ctrl_tb, cfg_ctrl);
+        });
+        delete cfg_ctrl;
+        close();
+        return sample;
+    });
+    bench.run("jtag", [&](bool trace, bool check) {
+        open(trace, check);
+        SPEED_SAMPLE sample = time_run(cfg_ctrl_tb, [&]() {
+            jtag_stream(cfg_ctrl_tb, options.cycles);
+        });
+        close();
+        return sample;
+    });
+
+    if (!options.json.empty() && !bench.write_json(options.json.c_str())) {
+        std::cerr << "Cannot write " << options.json << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*==============================================================================
+** Module: speed_global_buffer_int.cpp
+** Description: Simulator throughput benchmark for Global Buffer
+** NOTE:    Fixed workloads of --cycles cycles each (default 1M), every one
+**          with tracing off and on and with checks off and on, --reps
+**          times (see speed_bench.h):
+**          instream - INSTREAM of --stream-words words on all IO channels,
+**                     over and over
+**          cfg      - config streams of --stream-words words on all CFG
+**                     channels, over and over
+**          host     - host writes every cycle across all banks, then host
+**                     reads of the same words every cycle
+**          Results are printed in cycles/s and written as JSON with
+**          --json <file>.
+**============================================================================*/
+
+#include "glb_tb.h"
+#include "speed_bench.h"
+
+// Words per IO and config stream (--stream-words)
+unsigned long STREAM_WORDS = 4096;
+
+// Host writes of speed_data() to words [0, words) of the region at addr
+void preload(GLB_TB *tb, uint32_t addr, unsigned long words) {
+    for (unsigned long w=0; w<words; w++) {
+        tb->m_dut->host_wr_strb = 0xFF;
+        tb->m_dut->host_wr_addr = addr + 8*w;
+        tb->m_dut->host_wr_data = speed_data(addr + 8*w);
+        tb->tick();
+    }
+    tb->m_dut->host_wr_strb = 0;
+    tb->tick(10);
+}
+
+// As GLB_TB::cgra_test() without stalls. Checks io_to_cgra_rd_data of every
+// channel from the third cycle on.
+void instream(GLB_TB *tb, IO_CTRL *io_ctrl) {
+    Vglobal_buffer_int *dut = tb->m_dut;
+    dut->cgra_start_pulse = 1;
+    tb->tick();
+    dut->cgra_start_pulse = 0;
+    tb->io_ctrl_setup(io_ctrl);
+    tb->tick();
+    tb->run_until([dut]() { return dut->cgra_done_pulse == 1; }, STREAM_WORDS + 100,
+                  [&]() {
+                      if (!tb->checking())
+                          return;
+                      for (uint16_t i=0; i<NUM_IO; i++) {
+                          uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                          uint32_t int_addr = io_ctrl->get_int_addr(i);
+                          if (int_cnt == 0)
+                              continue;
+                          tb->my_assert(dut->io_to_cgra_rd_data_valid[i], 1, "io_to_cgra_rd_data_valid");
+                          tb->my_assert(dut->io_to_cgra_rd_data[i], glb->read_bytes(int_addr, 2), "io_to_cgra_rd_data");
+                          io_ctrl->set_int_addr(i, int_addr + 2);
+                          io_ctrl->set_int_cnt(i, int_cnt - 1);
+                      }
+                  }, "cgra_done_pulse");
+}
+
+void cfg_stream(GLB_TB *tb) {
+    Vglobal_buffer_int *dut = tb->m_dut;
+    uint16_t banks_per_cfg = NUM_BANKS / NUM_CFG;
+    std::vector<uint32_t> cfg_addr(NUM_CFG);
+    for (uint16_t i=0; i<NUM_CFG; i++)
+        cfg_addr[i] = (i * banks_per_cfg) << BANK_ADDR_WIDTH;
+    dut->config_start_pulse = 1;
+    tb->tick();
+    dut->config_start_pulse = 0;
+    tb->run_until([dut]() { return dut->config_done_pulse == 1; }, STREAM_WORDS + 100,
+                  [&]() {
+                      if (!tb->checking())
+                          return;
+                      for (uint16_t i=0; i<NUM_CFG; i++) {
+                          if (dut->glb_to_cgra_cfg_wr[i] != 1)
+                              continue;
+                          tb->my_assert_word(((uint64_t)dut->glb_to_cgra_cfg_addr[i] << 32) | dut->glb_to_cgra_cfg_data[i],
+                                             glb->read_word(cfg_addr[i]), "glb_to_cgra_cfg", 32);
+                          cfg_addr[i] += 8;
+                      }
+                  }, "config_done_pulse");
+}
+
+// Host words are spread across all banks, one bank after the other
+uint32_t host_addr(unsigned long w) {
+    return ((w % NUM_BANKS) << BANK_ADDR_WIDTH) + (w / NUM_BANKS) * 8;
+}
+
+// Reads are checked by the golden model of GLB_TB while checking is on.
+// Every round writes different data.
+void host_stream(GLB_TB *tb) {
+    Vglobal_buffer_int *dut = tb->m_dut;
+    for (unsigned long w=0; w<STREAM_WORDS; w++) {
+        dut->host_wr_strb = 0xFF;
+        dut->host_wr_addr = host_addr(w);
+        dut->host_wr_data = speed_data(host_addr(w)) ^ tb->tickcount();
+        tb->tick();
+    }
+    dut->host_wr_strb = 0;
+    for (unsigned long w=0; w<STREAM_WORDS; w++) {
+        dut->host_rd_en = 1;
+        dut->host_rd_addr = host_addr(w);
+        tb->tick();
+    }
+    dut->host_rd_en = 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    TB_ARGS tb_args;
+    SPEED_OPTIONS options;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "NUM_BANKS") {
+            NUM_BANKS = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_DATA_WIDTH") {
+            BANK_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CGRA_DATA_WIDTH") {
+            CGRA_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            // only sizes the RTL
+        }
+        else if (argv_tmp == "CFG_ADDR_WIDTH") {
+            CFG_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CFG_DATA_WIDTH") {
+            CFG_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--stream-words") {
+            STREAM_WORDS = stoul(argv[i+1], &pos);
+        }
+        else if (!options.parse(argv_tmp, argv[i+1]) && !tb_args.parse(argv_tmp, argv[i+1])) {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A fresh model and shadow for every run, so that every repetition
+    // simulates exactly the same cycles
+    GLB_TB *glb_tb = NULL;
+    auto open = [&](bool trace, bool check) {
+        glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH);
+        glb_tb = new GLB_TB();
+        glb_tb->trace_options(tb_args);
+        glb_tb->log_options(tb_args);
+        glb_tb->perf_options(tb_args);
+        glb_tb->checking(check);
+        if (trace)
+            glb_tb->opentrace("trace_speed_glb_int.vcd");
+    };
+    auto close = [&]() {
+        delete glb_tb;
+        delete glb;
+    };
+
+    SPEED_BENCH bench("global_buffer_int", options, tb_args.trace, tb_args.clock);
+    bench.run("instream", [&](bool trace, bool check) {
+        open(trace, check);
+        uint16_t banks_per_io = NUM_BANKS / NUM_IO;
+        IO_CTRL *io_ctrl = new IO_CTRL(NUM_IO);
+        for (uint16_t i=0; i<NUM_IO; i++) {
+            uint32_t start_addr = (i * banks_per_io) << BANK_ADDR_WIDTH;
+            preload(glb_tb, start_addr, (STREAM_WORDS + 3) / 4);
+            io_ctrl->set_mode(i, INSTREAM);
+            io_ctrl->set_start_addr(i, start_addr);
+            io_ctrl->set_num_words(i, STREAM_WORDS);
+            io_ctrl->set_switch_sel(i, (1 << banks_per_io) - 1);
+        }
+        glb_tb->glb_config_wr(io_ctrl);
+        unsigned long end = glb_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(glb_tb, [&]() {
+            while (glb_tb->tickcount() < end)
+                instream(glb_tb, io_ctrl);
+        });
+        delete io_ctrl;
+        close();
+        return sample;
+    });
+    bench.run("cfg", [&](bool trace, bool check) {
+        open(trace, check);
+        uint16_t banks_per_cfg = NUM_BANKS / NUM_CFG;
+        CFG_CTRL *cfg_ctrl = new CFG_CTRL(NUM_CFG);
+        for (uint16_t i=0; i<NUM_CFG; i++) {
+            uint32_t start_addr = (i * banks_per_cfg) << BANK_ADDR_WIDTH;
+            preload(glb_tb, start_addr, STREAM_WORDS);
+            cfg_ctrl->set_start_addr(i, start_addr);
+            cfg_ctrl->set_num_words(i, STREAM_WORDS);
+            cfg_ctrl->set_switch_sel(i, (1 << banks_per_cfg) - 1);
+        }
+        glb_tb->glb_config_wr(cfg_ctrl);
+        unsigned long end = glb_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(glb_tb, [&]() {
+            while (glb_tb->tickcount() < end)
+                cfg_stream(glb_tb);
+        });
+        delete cfg_ctrl;
+        close();
+        return sample;
+    });
+    bench.run("host", [&](bool trace, bool check) {
+        open(trace, check);
+        unsigned long end = glb_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(glb_tb, [&]() {
+            while (glb_tb->tickcount() < end)
+                host_stream(glb_tb);
+            // let the golden model retire the last reads
+            glb_tb->tick(10);
+        });
+        close();
+        return sample;
+    });
+
+    if (!options.json.empty() && !bench.write_json(options.json.c_str())) {
+        std::cerr << "Cannot write " << options.json << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
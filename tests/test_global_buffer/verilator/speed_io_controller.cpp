@@ -0,0 +1,191 @@
+/*==============================================================================
+** Module: speed_io_controller.cpp
+** Description: Simulator throughput benchmark for io controller
+** NOTE:    Fixed workloads of --cycles cycles each (default 1M), every one
+**          with tracing off and on and with checks off and on, --reps
+**          times (see speed_bench.h):
+**          instream  - INSTREAM of --stream-words words on all channels,
+**                      over and over
+**          outstream - OUTSTREAM of --stream-words words on all channels,
+**                      a word every cycle, over and over
+**          The bank model of IO_CTRL_TB runs either way, the DUT needs its
+**          read data. Results are printed in cycles/s and written as JSON
+**          with --json <file>.
+**============================================================================*/
+
+#include "io_ctrl_tb.h"
+#include "speed_bench.h"
+
+// Words per stream (--stream-words)
+unsigned long STREAM_WORDS = 4096;
+
+IO_CTRL *speed_io_ctrl(MODE mode) {
+    uint16_t banks_per_io = NUM_BANKS / NUM_IO;
+    IO_CTRL *io_ctrl = new IO_CTRL(NUM_IO);
+    for (uint16_t i=0; i<NUM_IO; i++) {
+        io_ctrl->set_mode(i, mode);
+        io_ctrl->set_start_addr(i, (i * banks_per_io) << BANK_ADDR_WIDTH);
+        io_ctrl->set_num_words(i, STREAM_WORDS);
+        io_ctrl->set_switch_sel(i, (1 << banks_per_io) - 1);
+    }
+    return io_ctrl;
+}
+
+// As IO_CTRL_TB::test() without stalls. Checks io_to_cgra_rd_data of every
+// channel from the third cycle on.
+void instream(IO_CTRL_TB *tb, IO_CTRL *io_ctrl) {
+    Vio_controller *dut = tb->m_dut;
+    dut->cgra_start_pulse = 1;
+    tb->tick();
+    dut->cgra_start_pulse = 0;
+    tb->io_ctrl_setup(io_ctrl);
+    tb->tick();
+    tb->run_until([dut]() { return dut->cgra_done_pulse == 1; }, STREAM_WORDS + 100,
+                  [&]() {
+                      if (!tb->checking())
+                          return;
+                      for (uint16_t i=0; i<NUM_IO; i++) {
+                          uint32_t int_cnt = io_ctrl->get_int_cnt(i);
+                          uint32_t int_addr = io_ctrl->get_int_addr(i);
+                          if (int_cnt == 0)
+                              continue;
+                          tb->my_assert(dut->io_to_cgra_rd_data_valid[i], 1, "io_to_cgra_rd_data_valid");
+                          tb->my_assert(dut->io_to_cgra_rd_data[i], glb->read_bytes(int_addr, 2), "io_to_cgra_rd_data");
+                          io_ctrl->set_int_addr(i, int_addr + 2);
+                          io_ctrl->set_int_cnt(i, int_cnt - 1);
+                      }
+                  }, "cgra_done_pulse");
+}
+
+// Word w of a stream of channel i
+uint16_t outstream_data(uint16_t i, unsigned long w, unsigned long round) {
+    return (uint16_t)speed_data((i << 24) + w + round);
+}
+
+// The CGRA writes a word every cycle. With checking on, the words the bank
+// model received are compared once the stream is done.
+void outstream(IO_CTRL_TB *tb, IO_CTRL *io_ctrl, unsigned long round) {
+    Vio_controller *dut = tb->m_dut;
+    dut->cgra_start_pulse = 1;
+    tb->tick();
+    dut->cgra_start_pulse = 0;
+    tb->io_ctrl_setup(io_ctrl);
+    tb->tick();
+    std::vector<unsigned long> words(NUM_IO, 0);
+    for (uint16_t i=0; i<NUM_IO; i++) {
+        dut->cgra_to_io_wr_en[i] = 1;
+        dut->cgra_to_io_wr_data[i] = outstream_data(i, 0, round);
+    }
+    tb->run_until([dut]() { return dut->cgra_done_pulse == 1; }, STREAM_WORDS + 100,
+                  [&]() {
+                      for (uint16_t i=0; i<NUM_IO; i++) {
+                          if (dut->cgra_to_io_wr_en[i] == 1)
+                              words[i]++;
+                          dut->cgra_to_io_wr_en[i] = words[i] < STREAM_WORDS;
+                          dut->cgra_to_io_wr_data[i] = outstream_data(i, words[i], round);
+                      }
+                  }, "cgra_done_pulse");
+    if (!tb->checking())
+        return;
+    for (uint16_t i=0; i<NUM_IO; i++) {
+        uint32_t start_addr = io_ctrl->get_start_addr(i);
+        for (unsigned long w=0; w<STREAM_WORDS; w++)
+            tb->my_assert(glb->read_bytes(start_addr + 2*w, 2), outstream_data(i, w, round), "io_to_bank_wr_data");
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    TB_ARGS tb_args;
+    SPEED_OPTIONS options;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_DATA_WIDTH") {
+            BANK_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            // only sizes the RTL
+        }
+        else if (argv_tmp == "CGRA_DATA_WIDTH") {
+            CGRA_DATA_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CONFIG_FEATURE_WIDTH") {
+            CONFIG_FEATURE_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "CONFIG_REG_WIDTH") {
+            CONFIG_REG_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--stream-words") {
+            STREAM_WORDS = stoul(argv[i+1], &pos);
+        }
+        else if (!options.parse(argv_tmp, argv[i+1]) && !tb_args.parse(argv_tmp, argv[i+1])) {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A fresh model and shadow for every run, so that every repetition
+    // simulates exactly the same cycles. Untouched words read as
+    // speed_data() of their address.
+    IO_CTRL_TB *io_ctrl_tb = NULL;
+    auto open = [&](bool trace, bool check) {
+        glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH,
+                [](uint32_t bank, uint32_t index) {
+                    return speed_data((bank << BANK_ADDR_WIDTH) + 8*index);
+                });
+        io_ctrl_tb = new IO_CTRL_TB();
+        io_ctrl_tb->trace_options(tb_args);
+        io_ctrl_tb->log_options(tb_args);
+        io_ctrl_tb->perf_options(tb_args);
+        io_ctrl_tb->checking(check);
+        if (trace)
+            io_ctrl_tb->opentrace("trace_speed_io_ctrl.vcd");
+    };
+    auto close = [&]() {
+        delete io_ctrl_tb;
+        delete glb;
+    };
+
+    SPEED_BENCH bench("io_controller", options, tb_args.trace, tb_args.clock);
+    bench.run("instream", [&](bool trace, bool check) {
+        open(trace, check);
+        IO_CTRL *io_ctrl = speed_io_ctrl(INSTREAM);
+        for (uint16_t i=0; i<NUM_IO; i++)
+            io_ctrl_tb->config_wr(io_ctrl->get_addr_gen(i));
+        unsigned long end = io_ctrl_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(io_ctrl_tb, [&]() {
+            while (io_ctrl_tb->tickcount() < end)
+                instream(io_ctrl_tb, io_ctrl);
+        });
+        delete io_ctrl;
+        close();
+        return sample;
+    });
+    bench.run("outstream", [&](bool trace, bool check) {
+        open(trace, check);
+        IO_CTRL *io_ctrl = speed_io_ctrl(OUTSTREAM);
+        for (uint16_t i=0; i<NUM_IO; i++)
+            io_ctrl_tb->config_wr(io_ctrl->get_addr_gen(i));
+        unsigned long end = io_ctrl_tb->tickcount() + options.cycles;
+        SPEED_SAMPLE sample = time_run(io_ctrl_tb, [&]() {
+            for (unsigned long round=0; io_ctrl_tb->tickcount() < end; round++)
+                outstream(io_ctrl_tb, io_ctrl, round);
+        });
+        delete io_ctrl;
+        close();
+        return sample;
+    });
+
+    if (!options.json.empty() && !bench.write_json(options.json.c_str())) {
+        std::cerr << "Cannot write " << options.json << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*==============================================================================
+** Module: sweep_io_controller.cpp
+** Description: Address space sweep of the io controller model
+** NOTE:    Runs IO_CTRL_MODEL (io_ctrl_model.h) alone, no Verilator model
+**          is needed:
+**              g++ -O2 -std=c++14 sweep_io_controller.cpp
+**          Every round all channels stream at once, each in the banks its
+**          switch_sel gives it: INSTREAM, OUTSTREAM and SRAM (a write then
+**          a read back of random addresses) of 1 to --words words with a
+**          random done_delay. Start addresses cycle through the start of
+**          a bank, across a bank boundary and anywhere in the banks of the
+**          channel. glc_to_io_stall is set with probability --stall and
+**          CGRA accesses happen with probability --wr-en. Every word read
+**          and written is checked against the bank model; cycles/s are
+**          printed per mode.
+**============================================================================*/
+
+#include "io_ctrl_model.h"
+#include "latency_queue.h"
+#include "shadow_memory.h"
+#include <chrono>
+#include <deque>
+#include <random>
+#include <string>
+
+// Address is byte addressable
+uint16_t NUM_BANKS = 32;
+uint16_t NUM_IO = 8;
+uint16_t BANK_ADDR_WIDTH = 17;
+uint16_t BANK_DATA_WIDTH = 64;
+uint16_t CGRA_DATA_WIDTH = 16;
+uint16_t GLB_ADDR_WIDTH = 32;
+
+using namespace std;
+
+GLB_SHADOW *glb;
+mt19937 rng;
+
+struct BANK_RD {
+    uint16_t bank;
+    uint32_t addr;
+};
+
+struct SWEEP_STATS {
+    unsigned long   streams;
+    unsigned long   cycles;
+    double          seconds;
+};
+
+void sweep_fail(const char *mode, unsigned round, uint16_t channel, const string &what) {
+    cerr << endl;  // end the current line
+    cerr << mode << " round " << dec << round << ", channel " << channel << ": " << what << endl;
+    exit(EXIT_FAILURE);
+}
+
+// A round of mode on every channel of model. The bank model answers reads
+// after one cycle like the one of IO_CTRL_TB.
+class SWEEP {
+public:
+    IO_CTRL_MODEL *model;
+    double stall;
+    double wr_en;
+    unsigned max_words;
+
+    SWEEP(IO_CTRL_MODEL *model, double stall, double wr_en, unsigned max_words)
+        : model(model), stall(stall), wr_en(wr_en), max_words(max_words), m_bank_rd(1) {
+        m_cycle = 0;
+    }
+
+    unsigned long run(MODE mode, unsigned round) {
+        IO_CTRL_MODEL &m = *model;
+        unsigned bpi = m.banks_per_io();
+        uint32_t bank_size = 1u << BANK_ADDR_WIDTH;
+        m_channels.assign(NUM_IO, CHANNEL());
+        for (uint16_t j=0; j<NUM_IO; j++) {
+            CHANNEL &ch = m_channels[j];
+            ch.num_words = 1 + rng() % max_words;
+            uint32_t first = (j*bpi) << BANK_ADDR_WIDTH;
+            uint32_t span = bpi * bank_size - 2*ch.num_words;
+            switch (round % 3) {
+            case 0:
+                ch.start_addr = first + (rng() % bpi) * bank_size;
+                break;
+            case 1:
+                ch.start_addr = first + (1 + rng() % (bpi-1)) * bank_size - 2*(rng() % ch.num_words + 1);
+                break;
+            default:
+                ch.start_addr = first + 2*(rng() % (span/2 + 1));
+                break;
+            }
+            ch.addr = ch.start_addr;
+            ch.data.resize(ch.num_words);
+            for (uint32_t k=0; k<ch.num_words; k++)
+                ch.data[k] = (uint16_t)rng();
+            // SRAM writes the first half and reads it back in the second
+            if (mode == SRAM) {
+                for (uint32_t k=0; k<(ch.num_words+1)/2; k++)
+                    ch.sram_addr.push_back(first + 2*(rng() % (bpi * bank_size/2)));
+            }
+            m.configure(j, mode, ch.start_addr, mode == SRAM ? 2*ch.sram_addr.size() : ch.num_words,
+                        (1 << bpi) - 1, rng() % 32);
+        }
+
+        unsigned long start = m_cycle;
+        m.cgra_start_pulse = 1;
+        cycle(mode, round);
+        m.cgra_start_pulse = 0;
+        unsigned long max_cycles = (unsigned long)(4 * max_words / (wr_en * (1 - stall))) + 1000;
+        while (!m.cgra_done_pulse) {
+            if (m_cycle - start > max_cycles)
+                sweep_fail(mode_name(mode), round, 0, "no cgra_done_pulse");
+            cycle(mode, round);
+        }
+        // cgra_done_pulse is not stalled, so with done_delay 0 it can come
+        // before the last words read do
+        for (unsigned t=0; t<100 && !complete(mode); t++)
+            cycle(mode, round);
+
+        for (uint16_t j=0; j<NUM_IO; j++) {
+            CHANNEL &ch = m_channels[j];
+            uint32_t expected = words(mode, ch);
+            if (ch.done != expected)
+                sweep_fail(mode_name(mode), round, j, to_string(ch.done) + " words instead of " + to_string(expected));
+            if (mode == OUTSTREAM) {
+                uint32_t k = glb->compare16(ch.start_addr, ch.data.data(), ch.num_words);
+                if (k != ch.num_words)
+                    sweep_fail(mode_name(mode), round, j, "word " + to_string(k) + " not written");
+            }
+        }
+        return m_cycle - start;
+    }
+
+    static const char *mode_name(MODE mode) {
+        const char *names[] = {"IDLE", "INSTREAM", "OUTSTREAM", "SRAM"};
+        return names[mode];
+    }
+
+private:
+    struct CHANNEL {
+        uint32_t            start_addr;
+        uint32_t            num_words;
+        uint32_t            addr;       // next word to stream
+        uint32_t            done;       // words streamed so far
+        uint32_t            issued;     // SRAM accesses so far
+        vector<uint16_t>    data;
+        vector<uint32_t>    sram_addr;
+        deque<uint32_t>     sram_rd;    // SRAM reads in flight
+
+        CHANNEL() : start_addr(0), num_words(0), addr(0), done(0), issued(0) {}
+    };
+
+    vector<CHANNEL>         m_channels;
+    LATENCY_QUEUE<BANK_RD>  m_bank_rd;
+    unsigned long           m_cycle;
+
+    static uint32_t words(MODE mode, const CHANNEL &ch) {
+        return mode == SRAM ? ch.sram_addr.size() : ch.num_words;
+    }
+
+    bool complete(MODE mode) {
+        for (const CHANNEL &ch : m_channels) {
+            if (ch.done != words(mode, ch))
+                return false;
+        }
+        return true;
+    }
+
+    bool chance(double p) {
+        return p >= 1 || (rng() & 0xFFFF) < p * 0x10000;
+    }
+
+    void cycle(MODE mode, unsigned round) {
+        IO_CTRL_MODEL &m = *model;
+        // a stalled cgra_start_pulse only clears the done flags, the
+        // address generators never see it
+        m.glc_to_io_stall = !m.cgra_start_pulse && chance(stall);
+        if (mode == OUTSTREAM) {
+            for (uint16_t j=0; j<NUM_IO; j++) {
+                CHANNEL &ch = m_channels[j];
+                m.cgra_to_io_wr_en[j] = ch.done < ch.num_words && !m.cgra_start_pulse && chance(wr_en);
+                m.cgra_to_io_wr_data[j] = ch.done < ch.num_words ? ch.data[ch.done] : 0;
+            }
+        }
+        else if (mode == SRAM) {
+            for (uint16_t j=0; j<NUM_IO; j++) {
+                CHANNEL &ch = m_channels[j];
+                uint32_t half = ch.sram_addr.size();
+                bool access = ch.issued < 2*half && !m.cgra_start_pulse && chance(wr_en);
+                bool write = ch.issued < half;
+                uint32_t addr = ch.sram_addr[ch.issued % half];
+                m.cgra_to_io_wr_en[j] = access && write;
+                m.cgra_to_io_rd_en[j] = access && !write;
+                m.cgra_to_io_wr_data[j] = ch.data[ch.issued % half];
+                m.cgra_to_io_addr_high[j] = addr >> CGRA_DATA_WIDTH;
+                m.cgra_to_io_addr_low[j] = addr & 0xFFFF;
+            }
+        }
+        m.eval();
+
+        if (!m.glc_to_io_stall) {
+            for (uint16_t j=0; j<NUM_IO; j++)
+                check(mode, round, j);
+        }
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m.io_to_bank_wr_en[i])
+                glb->merge(i, m.io_to_bank_wr_addr[i]>>3, m.io_to_bank_wr_data[i], m.io_to_bank_wr_data_bit_sel[i]);
+        }
+        m_bank_rd.retire(m_cycle, [&m](const BANK_RD &rd) {
+            m.bank_to_io_rd_data[rd.bank] = glb->read(rd.bank, rd.addr>>3);
+        });
+        for (uint16_t i=0; i<NUM_BANKS; i++) {
+            if (m.io_to_bank_rd_en[i])
+                m_bank_rd.push(m_cycle, {i, m.io_to_bank_rd_addr[i]});
+        }
+        m.clock();
+        m_cycle++;
+    }
+
+    // What channel j hands the CGRA or takes from it this cycle
+    void check(MODE mode, unsigned round, uint16_t j) {
+        IO_CTRL_MODEL &m = *model;
+        CHANNEL &ch = m_channels[j];
+        if (mode == INSTREAM && m.io_to_cgra_rd_data_valid[j]) {
+            if (ch.done == ch.num_words)
+                sweep_fail(mode_name(mode), round, j, "valid after the last word");
+            uint16_t expected = glb->read_bytes(ch.addr, 2);
+            if (m.io_to_cgra_rd_data[j] != expected)
+                sweep_fail(mode_name(mode), round, j, "word " + to_string(ch.done) + " read wrong");
+            ch.addr += 2;
+            ch.done++;
+        }
+        else if (mode == OUTSTREAM && m.cgra_to_io_wr_en[j]) {
+            ch.done++;
+        }
+        else if (mode == SRAM) {
+            if (m.io_to_cgra_rd_data_valid[j]) {
+                if (ch.sram_rd.empty())
+                    sweep_fail(mode_name(mode), round, j, "valid without a read");
+                uint16_t expected = glb->read_bytes(ch.sram_rd.front(), 2);
+                if (m.io_to_cgra_rd_data[j] != expected)
+                    sweep_fail(mode_name(mode), round, j, "read of " + to_string(ch.sram_rd.front()) + " wrong");
+                ch.sram_rd.pop_front();
+                ch.done++;
+            }
+            if (m.cgra_to_io_rd_en[j])
+                ch.sram_rd.push_back(m.cgra_to_io_addr_high[j] << CGRA_DATA_WIDTH | m.cgra_to_io_addr_low[j]);
+            if (m.cgra_to_io_wr_en[j] || m.cgra_to_io_rd_en[j])
+                ch.issued++;
+        }
+    }
+};
+
+int main(int argc, char **argv) {
+    if (argc % 2 == 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos;
+    unsigned seed = 0;
+    unsigned rounds = 300;
+    unsigned max_words = 512;
+    double stall = 0.1;
+    double wr_en = 0.8;
+    for (int i = 1; i < argc; i=i+2) {
+        string argv_tmp = argv[i];
+        if (argv_tmp == "--seed") {
+            seed = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--rounds") {
+            rounds = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--words") {
+            max_words = stoul(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--stall") {
+            stall = stod(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "--wr-en") {
+            wr_en = stod(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "BANK_ADDR_WIDTH") {
+            BANK_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else if (argv_tmp == "GLB_ADDR_WIDTH") {
+            GLB_ADDR_WIDTH = stoi(argv[i+1], &pos);
+        }
+        else {
+            printf("\nParameter wrong!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_words == 0 || 2*max_words >= (1u << BANK_ADDR_WIDTH) || stall >= 1 || wr_en <= 0) {
+        printf("\nParameter wrong!\n");
+        return EXIT_FAILURE;
+    }
+
+    // rerun with --seed to reproduce a failure
+    printf("Seed: %u\n", seed);
+    rng.seed(seed);
+    glb = new GLB_SHADOW(NUM_BANKS, BANK_ADDR_WIDTH,
+            [](uint32_t bank, uint32_t index) {
+                return ((uint64_t)bank << 48) ^ ((uint64_t)index * 0x9E3779B97F4A7C15ULL);
+            });
+    IO_CTRL_MODEL *model = new IO_CTRL_MODEL(NUM_BANKS, NUM_IO, BANK_ADDR_WIDTH, BANK_DATA_WIDTH,
+                                             CGRA_DATA_WIDTH, GLB_ADDR_WIDTH);
+    model->reset = 1;
+    model->eval();
+    model->clock();
+    model->reset = 0;
+
+    SWEEP sweep(model, stall, wr_en, max_words);
+    const MODE modes[] = {INSTREAM, OUTSTREAM, SRAM};
+    for (MODE mode : modes) {
+        SWEEP_STATS stats = {0, 0, 0};
+        auto t0 = chrono::steady_clock::now();
+        for (unsigned r=0; r<rounds; r++)
+            stats.cycles += sweep.run(mode, r);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+        stats.seconds = elapsed.count();
+        stats.streams = (unsigned long)rounds * NUM_IO;
+        printf("%-9s: %lu streams, %lu cycles in %.3f s (%.0f cycles/s)\n",
+               SWEEP::mode_name(mode), stats.streams, stats.cycles, stats.seconds,
+               stats.cycles / stats.seconds);
+    }
+    printf("Shadow memory: %lu pages (%lu KB)\n", glb->num_pages(), glb->bytes() >> 10);
+    printf("\nAll sweeps are passed!\n");
+    delete model;
+    delete glb;
+    return EXIT_SUCCESS;
+}
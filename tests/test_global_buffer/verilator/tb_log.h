@@ -0,0 +1,122 @@
+#ifndef TB_LOG_H
+#define TB_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Log levels. Messages above the runtime verbosity (--verbosity, default
+// LOG_INFO) are skipped before any formatting is done.
+#define LOG_ERROR   0
+#define LOG_INFO    1
+#define LOG_DEBUG   2
+
+// Messages above TB_LOG_LEVEL are compiled out, e.g. -DTB_LOG_LEVEL=1
+// removes every per-cycle LOG_DEBUG message from the binary.
+#ifndef TB_LOG_LEVEL
+#define TB_LOG_LEVEL LOG_DEBUG
+#endif
+
+#define TB_LOG(level, ...)                                              \
+    do {                                                                \
+        if ((level) <= TB_LOG_LEVEL && (level) <= tb_log.verbosity)     \
+            printf(__VA_ARGS__);                                        \
+    } while (0)
+
+// Binary event log format (little endian), decoded by tb_event_log.py:
+//   "TBEVLOG1"
+//   'D' <uint16 id> <uint8 length> <name>          event definition
+//   'E' <uint16 id> <uint16 channel> <uint32 addr>
+//       <uint64 cycle> <uint64 data>               event
+#define TB_EVENT_MAGIC "TBEVLOG1"
+
+class TB_LOGGER {
+public:
+    int verbosity;
+
+    // stdout is made fully buffered with a large buffer. This runs before
+    // main(), so before anything is written to it.
+    TB_LOGGER(void) {
+        verbosity = LOG_INFO;
+        m_events = NULL;
+        // static storage, so it outlives the final flush in exit()
+        static char buffer[1 << 20];
+        setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+    }
+
+    ~TB_LOGGER(void) {
+        close_events();
+        fflush(stdout);
+    }
+
+    // Write everything logged so far, e.g. before reporting an error on
+    // stderr
+    void flush(void) {
+        fflush(stdout);
+        if (m_events)
+            fflush(m_events);
+    }
+
+    bool open_events(const char *filename) {
+        close_events();
+        m_events = fopen(filename, "wb");
+        if (m_events == NULL)
+            return false;
+        fwrite(TB_EVENT_MAGIC, 1, 8, m_events);
+        for (size_t id=0; id<m_event_names.size(); id++) {
+            if (!m_event_names[id].empty())
+                write_definition(id);
+        }
+        return true;
+    }
+
+    void close_events(void) {
+        if (m_events) {
+            fclose(m_events);
+            m_events = NULL;
+        }
+    }
+
+    bool events(void) {
+        return m_events != NULL;
+    }
+
+    // Give event id a name for the decoder
+    void define_event(uint16_t id, const std::string &name) {
+        if (m_event_names.size() <= id)
+            m_event_names.resize(id+1);
+        m_event_names[id] = name.substr(0, 255);
+        if (m_events)
+            write_definition(id);
+    }
+
+    void event(uint64_t cycle, uint16_t id, uint16_t channel, uint32_t addr,
+               uint64_t data) {
+        if (m_events == NULL)
+            return;
+        fputc('E', m_events);
+        fwrite(&id, sizeof(id), 1, m_events);
+        fwrite(&channel, sizeof(channel), 1, m_events);
+        fwrite(&addr, sizeof(addr), 1, m_events);
+        fwrite(&cycle, sizeof(cycle), 1, m_events);
+        fwrite(&data, sizeof(data), 1, m_events);
+    }
+
+private:
+    FILE                        *m_events;
+    std::vector<std::string>    m_event_names;
+
+    void write_definition(uint16_t id) {
+        uint8_t length = m_event_names[id].size();
+        fputc('D', m_events);
+        fwrite(&id, sizeof(id), 1, m_events);
+        fwrite(&length, sizeof(length), 1, m_events);
+        fwrite(m_event_names[id].data(), 1, length, m_events);
+    }
+};
+
+// One logger per testbench executable
+static TB_LOGGER tb_log;
+
+#endif
@@ -2,34 +2,210 @@
 #define TESTBENCH_H
 
 #include <iostream>
+#include <functional>
+#include <string>
+#include <chrono>
+#include <climits>
+#include <ctime>
 #include <stdio.h>
 #include <stdint.h>
+#include <sys/resource.h>
+#include "flight_recorder.h"
+#include "lockstep.h"
+#include "tb_log.h"
+#include "latency_queue.h"
+
+// A Verilated model supports a single trace format, chosen when it is
+// verilated (--trace or --trace-fst). run_verilator(trace="fst") defines
+// TRACE_FST to match.
+#ifdef TRACE_FST
+#include <verilated_fst_c.h>
+typedef VerilatedFstC TRACE_FILE;
+#define TRACE_EXT ".fst"
+#else
 #include <verilated_vcd_c.h>
+typedef VerilatedVcdC TRACE_FILE;
+#define TRACE_EXT ".vcd"
+#endif
+
+// Models verilated with --savable can be checkpointed, see
+// TESTBENCH::save(). run_verilator(savable=True) defines TB_SAVABLE to match.
+#ifdef TB_SAVABLE
+#include <verilated_save.h>
+#endif
+
+// Models verilated with --threads share a VerilatedContext with the
+// harness. Older Verilator releases only have the global Verilated state.
+#if defined(VERILATOR_VERSION_INTEGER) && VERILATOR_VERSION_INTEGER >= 4200000
+#define TB_CONTEXT
+#endif
+
+// Since Verilator 4.210 the ports and public signals of a model live in its
+// root instance, the model class only holds references to them.
+#if defined(VERILATOR_VERSION_INTEGER) && VERILATOR_VERSION_INTEGER >= 4210000
+#define TB_ROOT(dut) ((dut)->rootp)
+#else
+#define TB_ROOT(dut) (dut)
+#endif
+
+// Harness options. They are passed on the command line as "--name value"
+// pairs next to the RTL parameters, e.g. "--trace-start 1000".
+struct TB_ARGS {
+    bool            trace;
+    int             trace_depth;
+    unsigned long   trace_start;
+    unsigned long   trace_stop;
+    unsigned long   trace_flush;
+    std::string     trace_trigger;
+    unsigned long   record;
+    std::string     record_signals;
+    unsigned int    seed;
+    int             verbosity;
+    std::string     event_log;
+    bool            perf;
+    std::string     perf_json;
+    std::string     clock;      // full, fast or lockstep
+
+    TB_ARGS(void) {
+        trace = true;
+        trace_depth = 99;
+        trace_start = 0;
+        trace_stop = ULONG_MAX;
+        trace_flush = 1;
+        trace_trigger = "";
+        record = 0;
+        record_signals = "";
+        seed = (unsigned int)time(NULL);
+        verbosity = LOG_INFO;
+        event_log = "";
+        perf = false;
+        perf_json = "";
+        clock = "full";
+    }
+
+    // returns false if key is not a harness option
+    bool parse(const std::string &key, const char *value) {
+        if (key == "--trace")
+            trace = std::stoi(value) != 0;
+        else if (key == "--trace-depth")
+            trace_depth = std::stoi(value);
+        else if (key == "--trace-start")
+            trace_start = std::stoul(value);
+        else if (key == "--trace-stop")
+            trace_stop = std::stoul(value);
+        else if (key == "--trace-flush")
+            trace_flush = std::stoul(value);
+        else if (key == "--trace-trigger")
+            trace_trigger = value;
+        else if (key == "--record")
+            record = std::stoul(value);
+        else if (key == "--record-signals")
+            record_signals = value;
+        else if (key == "--seed")
+            seed = (unsigned int)std::stoul(value);
+        else if (key == "--verbosity")
+            verbosity = std::stoi(value);
+        else if (key == "--event-log")
+            event_log = value;
+        else if (key == "--perf")
+            perf = std::stoi(value) != 0;
+        else if (key == "--perf-json")
+            perf_json = value;
+        else if (key == "--clock") {
+            clock = value;
+            if (clock != "full" && clock != "fast" && clock != "lockstep") {
+                std::cerr << "Unknown --clock " << clock
+                          << ", expected full, fast or lockstep" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+            return false;
+        return true;
+    }
+};
 
 template<class VMODULE> class TESTBENCH {
 public:
+    typedef std::function<bool(VMODULE*)> trace_pred_t;
+
     unsigned long   m_tickcount;
+    unsigned long   m_config_cycles;
     VMODULE         *m_dut;
-    VerilatedVcdC   *m_trace;
+    TRACE_FILE      *m_trace;
+    FLIGHT_RECORDER *m_recorder;
+    VMODULE         *m_ref;         // reference model of the lockstep check
+#ifdef TB_CONTEXT
+    VerilatedContext *m_context;
+    VerilatedContext *m_ref_context;
+#endif
 
     TESTBENCH(void) {
-        m_dut = new VMODULE;
+#ifdef TB_CONTEXT
+        m_context = new VerilatedContext;
+        m_context->traceEverOn(true);
+        m_dut = new VMODULE(m_context);
+#else
         Verilated::traceEverOn(true);
+        m_dut = new VMODULE;
+#endif
         m_dut->clk = 0;
+        m_tickcount = 0;
+        m_config_cycles = 0;
+        m_restored_ticks = 0;
+        m_trace = NULL;
+        m_recorder = NULL;
+        m_ref = NULL;
+        m_lockstep = NULL;
+        m_fast_clock = false;
+        m_trace_armed = false;
+        m_trace_on = false;
+        m_trace_depth = 99;
+        m_trace_flush = 1;
+        m_trace_start = 0;
+        m_trace_stop = ULONG_MAX;
+        m_trace_length = 0;
+        m_trace_on_assert = false;
+        m_check = true;
+        m_perf_on = false;
+        m_slow_tick = false;
+        m_perf_eval = m_perf_update = m_perf_trace = 0;
+        m_start_time = std::chrono::steady_clock::now();
         eval();
     }
 
     virtual ~TESTBENCH(void) {
         closetrace();
+        closerecorder();
+        delete m_lockstep;
+        if (m_ref) {
+            m_ref->final();
+            delete m_ref;
+#ifdef TB_CONTEXT
+            delete m_ref_context;
+#endif
+        }
+        m_dut->final();
         delete m_dut;
         m_dut = NULL;
+#ifdef TB_CONTEXT
+        delete m_context;
+#endif
     }
 
-    virtual void opentrace(const char *vcdname) {
+    // The extension of tracename is replaced by the one of the format the
+    // model was built with.
+    virtual void opentrace(const char *tracename) {
         if (!m_trace) {
-            m_trace = new VerilatedVcdC;
-            m_dut->trace(m_trace, 99); //Trace 99 levels of hierarchy
-            m_trace->open(vcdname);
+            std::string filename = tracename;
+            size_t dot = filename.rfind('.');
+            if (dot != std::string::npos)
+                filename = filename.substr(0, dot);
+            filename += TRACE_EXT;
+            m_trace = new TRACE_FILE;
+            m_dut->trace(m_trace, m_trace_depth);
+            m_trace->open(filename.c_str());
+            rearm();
         }
     }
 
@@ -39,6 +215,157 @@ public:
             delete m_trace;
             m_trace = NULL;
         }
+        m_trace_armed = false;
+        m_trace_on = false;
+        select_tick();
+    }
+
+    // Keep the last depth cycles of the ports selected by filter in memory
+    // and write them to vcdname only when my_assert fails.
+    void openrecorder(const char *vcdname, unsigned long depth,
+                      const std::string &filter="") {
+        if (!m_recorder) {
+            m_recorder = new FLIGHT_RECORDER(depth, filter);
+            m_recorder_file = vcdname;
+            probe_ports(m_recorder);
+            if (m_recorder->num_probes() == 0) {
+                std::cerr << "Flight recorder: no port matches \"" << filter
+                          << "\", nothing is recorded" << std::endl;
+                closerecorder();
+            }
+            select_tick();
+        }
+    }
+
+    void closerecorder(void) {
+        delete m_recorder;
+        m_recorder = NULL;
+        select_tick();
+    }
+
+    // Derived testbenches register the DUT ports the flight recorder can
+    // keep and the lockstep check compares.
+    virtual void probe_ports(PORT_PROBE *) {}
+
+    // Leave out the eval() of the falling clock edge. Nothing in these
+    // designs is sensitive to it, so the eval() settling the next cycle
+    // covers it: two evals a cycle instead of three. Traced cycles still
+    // take it so that waveforms show the clock going low.
+    void fast_clock(bool on) {
+        m_fast_clock = on;
+    }
+
+    bool fast_clock(void) {
+        return m_fast_clock;
+    }
+
+    // Clock the DUT with the fast clock and a second model of the same RTL
+    // with the full one, on the same stimulus, and fail on the first cycle
+    // a probed port differs between the two.
+    void clock_lockstep(void) {
+        if (m_lockstep)
+            return;
+#ifdef TB_CONTEXT
+        m_ref_context = new VerilatedContext;
+        m_ref = new VMODULE(m_ref_context);
+#else
+        m_ref = new VMODULE;
+#endif
+        m_lockstep = new LOCKSTEP(TB_ROOT(m_dut), TB_ROOT(m_ref));
+        probe_ports(m_lockstep);
+        select_tick();
+        m_fast_clock = true;
+        m_ref->clk = 0;
+        m_lockstep->drive();
+        m_ref->eval();
+        if (m_tickcount == 0)
+            return;
+        // The DUT has been clocked already, catch up from a reset
+        m_ref->reset = 1;
+        for (int t=0; t<5; t++)
+            full_tick(m_ref);
+        m_ref->reset = m_dut->reset;
+        m_ref->eval();
+    }
+
+    // Apply the trace options given on the command line. Must be called
+    // before opentrace() for trace_depth to take effect.
+    void trace_options(const TB_ARGS &args) {
+        m_trace_depth = args.trace_depth;
+        m_trace_flush = args.trace_flush;
+        trace_window(args.trace_start, args.trace_stop);
+        if (args.trace_trigger == "assert")
+            trace_on_assert();
+    }
+
+    // Apply the logging options given on the command line
+    void log_options(const TB_ARGS &args) {
+        tb_log.verbosity = args.verbosity;
+        if (!args.event_log.empty() && !tb_log.open_events(args.event_log.c_str()))
+            std::cerr << "Cannot open event log " << args.event_log << std::endl;
+    }
+
+    // Apply the performance report options given on the command line
+    void perf_options(const TB_ARGS &args) {
+        m_perf_on = args.perf || !args.perf_json.empty();
+        select_tick();
+        m_perf_json = args.perf_json;
+        if (args.clock == "fast")
+            fast_clock(true);
+        else if (args.clock == "lockstep")
+            clock_lockstep();
+    }
+
+    // Record an event in the binary event log, if there is one
+    void log_event(uint16_t id, uint16_t channel, uint32_t addr, uint64_t data) {
+        if (tb_log.events())
+            tb_log.event(m_tickcount, id, channel, addr, data);
+    }
+
+    // Only dump cycles in [start, stop)
+    void trace_window(unsigned long start, unsigned long stop) {
+        m_trace_start = start;
+        m_trace_stop = stop;
+        m_trace_length = 0;
+        rearm();
+    }
+
+    // Start dumping on the first cycle start_pred is true and stop after
+    // length cycles (0: never) or once stop_pred is true.
+    void trace_trigger(trace_pred_t start_pred, unsigned long length=0,
+                       trace_pred_t stop_pred=nullptr) {
+        m_trace_start_pred = start_pred;
+        m_trace_stop_pred = stop_pred;
+        m_trace_length = length;
+        m_trace_start = 0;
+        m_trace_stop = ULONG_MAX;
+        rearm();
+    }
+
+    // Do not dump anything until my_assert fails, then dump the failing
+    // cycle.
+    void trace_on_assert(void) {
+        m_trace_on_assert = true;
+        rearm();
+    }
+
+    // Flush the trace file every interval cycles. 0 only flushes on close.
+    void trace_flush_interval(unsigned long interval) {
+        m_trace_flush = interval;
+    }
+
+    bool tracing(void) {
+        return m_trace_on;
+    }
+
+    // Golden model checks are on unless switched off, which the speed
+    // benchmarks do to time the model and its stimulus alone
+    void checking(bool on) {
+        m_check = on;
+    }
+
+    bool checking(void) {
+        return m_check;
     }
 
     virtual void eval(void) {
@@ -49,6 +376,124 @@ public:
         return m_tickcount;
     }
 
+    // Cycles spent on config register accesses
+    unsigned long config_cycles(void) {
+        return m_config_cycles;
+    }
+
+    // Simulated cycles per wall-clock second since construction. Cycles
+    // that came with a restored checkpoint or from a parent process do not
+    // count.
+    double ticks_per_sec(void) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - m_start_time;
+        return (m_tickcount - m_restored_ticks) / elapsed.count();
+    }
+
+    // Print simulated cycles, wall-clock time and peak RSS. With --perf,
+    // also where the time went: eval() of the model, update() of the
+    // golden model (and the reference model of the lockstep check), trace
+    // dumping, and the driver itself for the rest.
+    // Written as JSON as well with --perf-json.
+    void perf_report(void) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - m_start_time;
+        double wall = elapsed.count();
+        unsigned long ticks = m_tickcount - m_restored_ticks;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        unsigned long peak_rss = usage.ru_maxrss;  // KB on Linux
+        printf("Simulated %lu cycles in %.2f s (%.0f cycles/s), peak RSS %lu MB\n",
+               ticks, wall, ticks / wall, peak_rss >> 10);
+        if (!m_perf_on)
+            return;
+        double driver = wall - m_perf_eval - m_perf_update - m_perf_trace;
+        printf("Time: eval %.1f%% / update %.1f%% / trace %.1f%% / driver %.1f%%\n",
+               100*m_perf_eval/wall, 100*m_perf_update/wall, 100*m_perf_trace/wall, 100*driver/wall);
+        if (m_perf_json.empty())
+            return;
+        FILE *f = fopen(m_perf_json.c_str(), "w");
+        if (f == NULL) {
+            std::cerr << "Cannot write " << m_perf_json << std::endl;
+            return;
+        }
+        fprintf(f, "{\"cycles\": %lu, \"wall_s\": %.6f, \"cycles_per_s\": %.1f, \"peak_rss_kb\": %lu, "
+                   "\"eval_s\": %.6f, \"update_s\": %.6f, \"trace_s\": %.6f, \"driver_s\": %.6f}\n",
+                ticks, wall, ticks / wall, peak_rss,
+                m_perf_eval, m_perf_update, m_perf_trace, driver);
+        fclose(f);
+    }
+
+#ifdef TB_SAVABLE
+    // Write the model and the harness state to filename, e.g. once reset
+    // and configuration are done, so that many scenarios can start from
+    // there with restore(). Returns false if the file cannot be written.
+    bool save(const char *filename) {
+        VerilatedSave os;
+        os.open(filename);
+        if (!os.isOpen())
+            return false;
+        os.write(&m_tickcount, sizeof(m_tickcount));
+        os.write(&m_config_cycles, sizeof(m_config_cycles));
+        os << *m_dut;
+        save_state(os);
+        os.close();
+        return true;
+    }
+
+    // Continue from a checkpoint written by save() with a model of the same
+    // RTL and parameters. Returns false if the file cannot be read.
+    bool restore(const char *filename) {
+        VerilatedRestore os;
+        os.open(filename);
+        if (!os.isOpen())
+            return false;
+        os.read(&m_tickcount, sizeof(m_tickcount));
+        os.read(&m_config_cycles, sizeof(m_config_cycles));
+        os >> *m_dut;
+        restore_state(os);
+        os.close();
+        if (m_ref) {
+            // the reference model of the lockstep check restarts from the
+            // same state
+            VerilatedRestore ref_os;
+            ref_os.open(filename);
+            unsigned long counts[2];
+            ref_os.read(counts, sizeof(counts));
+            ref_os >> *m_ref;
+            ref_os.close();
+        }
+        m_restored_ticks = m_tickcount;
+        rearm();
+        return true;
+    }
+
+    // Derived testbenches add the state of their golden model
+    virtual void save_state(VerilatedSerialize &) {}
+    virtual void restore_state(VerilatedDeserialize &) {}
+#endif
+
+    // Called in a child forked from this testbench, see fork_scenarios().
+    // The trace and the event log stay with the parent: the child drops its
+    // copy of the trace without writing it and closes its copy of the
+    // event log, which the parent flushed before forking. The flight
+    // recorder dumps to a file of its own, and the performance report only
+    // counts the child's cycles.
+    virtual void forked(unsigned scenario) {
+        m_trace = NULL;
+        m_trace_armed = false;
+        m_trace_on = false;
+        select_tick();
+        tb_log.close_events();
+        size_t dot = m_recorder_file.rfind('.');
+        if (dot == std::string::npos)
+            dot = m_recorder_file.size();
+        m_recorder_file.insert(dot, "_" + std::to_string(scenario));
+        m_restored_ticks = m_tickcount;
+        m_start_time = std::chrono::steady_clock::now();
+        m_perf_eval = m_perf_update = m_perf_trace = 0;
+    }
+
     virtual void reset(void) {
         m_dut->reset = 1;
         this->tick();
@@ -57,32 +502,74 @@ public:
         this->tick();
         this->tick();
         m_dut->reset = 0;
-#ifdef DEBUG
-        printf("Reset\n");
-#endif
+        TB_LOG(LOG_DEBUG, "Reset\n");
     }
-    
+
+    // Golden model hook for derived testbenches. Called every cycle once
+    // combinational logic has settled, before the rising edge.
+    virtual void update(void) {}
+
+    // Without timing, flight recorder, lockstep check or trace this is a
+    // single branch on top of settling and clocking the DUT
     virtual void tick(void) {
         m_tickcount++;
+        if (m_slow_tick) {
+            slow_tick();
+            return;
+        }
 
         // All combinational logic should be settled
         // before we tick the clock
         eval();
-        if(m_trace) m_trace->dump(10*m_tickcount-4);
+        update();
+        clock_edges();
+    }
 
-        // Toggle the clock
-        // Rising edge
-        m_dut->clk = 1;
-        m_dut->eval();
-        if(m_trace) m_trace->dump(10*m_tickcount);
+    // Batch stepping. These call TESTBENCH::tick() directly, so per-cycle
+    // work of derived testbenches has to live in update().
+    void tick(unsigned long n) {
+        for (unsigned long t=0; t<n; t++)
+            TESTBENCH::tick();
+    }
 
-        // Falling edge
-        m_dut->clk = 0;
-        m_dut->eval();
-        if(m_trace) {
-            m_trace->dump(10*m_tickcount+5);
-            m_trace->flush();
+    // Tick until pred is true, calling body after every cycle. Fails with a
+    // timeout instead of hanging if pred is still false after max_cycles.
+    // Returns the number of cycles ticked.
+    unsigned long run_until(std::function<bool(void)> pred,
+                            unsigned long max_cycles,
+                            std::function<void(void)> body=nullptr,
+                            const char *what="run_until") {
+        unsigned long cycles = 0;
+        while (!pred()) {
+            if (cycles == max_cycles)
+                timeout(what, max_cycles);
+            TESTBENCH::tick();
+            if (body) body();
+            cycles++;
         }
+        return cycles;
+    }
+
+    unsigned long run_while(std::function<bool(void)> pred,
+                            unsigned long max_cycles,
+                            std::function<void(void)> body=nullptr,
+                            const char *what="run_while") {
+        return run_until([&pred]() { return !pred(); }, max_cycles, body,
+                         what);
+    }
+
+    // The config ports have no ready/valid handshake: read data is valid a
+    // fixed number of cycles after the request, which depends on the path.
+    // Holds the request for latency cycles, settles the DUT and calls check
+    // in the cycle the data is valid, then ends that cycle as well. Returns
+    // the cycles the read took.
+    unsigned long read_at_latency(unsigned latency, std::function<void(void)> check) {
+        for (unsigned t=0; t<latency; t++)
+            tick();
+        eval();
+        check();
+        tick();
+        return latency + 1;
     }
 
     void my_assert(
@@ -90,12 +577,230 @@ public:
             uint64_t expected,
             const char* port) {
         if (got != expected) {
+            tb_log.flush();
             std::cerr << std::endl;  // end the current line
             std::cerr << "Got      : 0x" << std::hex << got << std::endl;
             std::cerr << "Expected : 0x" << std::hex << expected << std::endl;
             std::cerr << "Port     : " << port << std::endl;
-            m_trace->close();
-            exit(EXIT_FAILURE);
+            fail();
+        }
+    }
+
+    // Compare a whole bank word at once. Lanes of lane_width bits are only
+    // decoded to report a mismatch.
+    void my_assert_word(
+            uint64_t got,
+            uint64_t expected,
+            const char* port,
+            int lane_width=16,
+            uint64_t mask=~0ULL) {
+        uint64_t diff = (got ^ expected) & mask;
+        if (diff != 0) {
+            uint64_t lane_mask = (lane_width >= 64) ? ~0ULL : ((1ULL << lane_width) - 1);
+            tb_log.flush();
+            std::cerr << std::endl;  // end the current line
+            std::cerr << "Got      : 0x" << std::hex << (got & mask) << std::endl;
+            std::cerr << "Expected : 0x" << std::hex << (expected & mask) << std::endl;
+            for (int lane=0; lane*lane_width < 64; lane++) {
+                if (((diff >> (lane*lane_width)) & lane_mask) == 0)
+                    continue;
+                std::cerr << "Lane " << std::dec << lane << "   : got 0x" << std::hex
+                          << ((got >> (lane*lane_width)) & lane_mask) << ", expected 0x"
+                          << ((expected >> (lane*lane_width)) & lane_mask) << std::endl;
+            }
+            std::cerr << "Port     : " << port << std::endl;
+            fail();
+        }
+    }
+
+    void timeout(const char *what, unsigned long max_cycles) {
+        tb_log.flush();
+        std::cerr << std::endl;  // end the current line
+        std::cerr << "Timeout  : " << what << " after " << std::dec
+                  << max_cycles << " cycles" << std::endl;
+        std::cerr << "Cycle    : " << std::dec << m_tickcount << std::endl;
+        fail();
+    }
+
+    // Flush whatever debug information we have and exit
+    void fail(void) {
+        tb_log.flush();
+        if (m_trace && m_trace_on_assert && !m_trace_on)
+            m_trace->dump(10*m_tickcount+5);
+        closetrace();
+        if (m_recorder && m_recorder->dump(m_recorder_file.c_str())) {
+            std::cerr << "Last cycles: " << m_recorder_file << std::endl;
+        }
+        perf_report();
+        exit(EXIT_FAILURE);
+    }
+
+private:
+    std::string     m_recorder_file;
+    unsigned long   m_restored_ticks;   // m_tickcount of the checkpoint or fork
+    std::chrono::steady_clock::time_point m_start_time;
+    bool            m_trace_armed;  // tick() has to look at the trace
+    bool            m_trace_on;     // cycles are being dumped
+    int             m_trace_depth;
+    unsigned long   m_trace_flush;
+    unsigned long   m_trace_start;
+    unsigned long   m_trace_stop;
+    unsigned long   m_trace_length;
+    bool            m_trace_on_assert;
+    trace_pred_t    m_trace_start_pred;
+    trace_pred_t    m_trace_stop_pred;
+    bool            m_check;
+    bool            m_fast_clock;   // skip the falling edge eval()
+    LOCKSTEP        *m_lockstep;
+    bool            m_perf_on;      // time the phases of tick()
+    bool            m_slow_tick;    // any of the per-cycle extras is on
+    std::string     m_perf_json;
+    double          m_perf_eval;    // seconds
+    double          m_perf_update;
+    double          m_perf_trace;
+
+    static double perf_now(void) {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Pick the tick() of the per-cycle extras whenever one of them changes
+    void select_tick(void) {
+        m_slow_tick = m_perf_on || m_recorder || m_lockstep || m_trace_armed;
+    }
+
+    // tick() with the per-cycle extras
+    void slow_tick(void) {
+        if (m_perf_on) {
+            profiled_tick();
+            return;
+        }
+        eval();
+        update();
+        if (m_recorder) m_recorder->sample(m_tickcount);
+        if (m_lockstep) ref_tick();
+
+        if (m_trace_armed)
+            traced_tick();
+        else
+            clock_edges();
+        if (m_lockstep) lockstep_check();
+    }
+
+    // tick() with every phase timed
+    void profiled_tick(void) {
+        double t0 = perf_now();
+        eval();
+        double t1 = perf_now();
+        update();
+        if (m_recorder) m_recorder->sample(m_tickcount);
+        if (m_lockstep) ref_tick();
+        double t2 = perf_now();
+        m_perf_eval += t1 - t0;
+        m_perf_update += t2 - t1;
+
+        if (m_trace_armed) {
+            double trace = m_perf_trace;
+            traced_tick();
+            m_perf_eval += perf_now() - t2 - (m_perf_trace - trace);
+        } else {
+            clock_edges();
+            m_perf_eval += perf_now() - t2;
+        }
+        if (m_lockstep) lockstep_check();
+    }
+
+    // Rising edge, then the falling edge unless the clock is fast
+    void clock_edges(void) {
+        m_dut->clk = 1;
+        m_dut->eval();
+        m_dut->clk = 0;
+        if (!m_fast_clock)
+            m_dut->eval();
+    }
+
+    // The full scheme: settle, rising edge, falling edge
+    static void full_tick(VMODULE *model) {
+        model->eval();
+        model->clk = 1;
+        model->eval();
+        model->clk = 0;
+        model->eval();
+    }
+
+    // The reference model sees what the harness drove on the DUT this cycle
+    void ref_tick(void) {
+        m_lockstep->drive();
+        full_tick(m_ref);
+    }
+
+    void lockstep_check(void) {
+        int i = m_lockstep->mismatch();
+        if (i < 0)
+            return;
+        tb_log.flush();
+        std::cerr << std::endl;  // end the current line
+        std::cerr << "Got      : 0x" << std::hex << m_lockstep->dut_value(i) << " (fast clock)" << std::endl;
+        std::cerr << "Expected : 0x" << std::hex << m_lockstep->ref_value(i) << " (full clock)" << std::endl;
+        std::cerr << "Port     : " << m_lockstep->name(i) << std::endl;
+        std::cerr << "Cycle    : " << std::dec << m_tickcount << std::endl;
+        fail();
+    }
+
+    void dump(uint64_t time) {
+        if (!m_perf_on) {
+            m_trace->dump(time);
+            return;
+        }
+        double t0 = perf_now();
+        m_trace->dump(time);
+        m_perf_trace += perf_now() - t0;
+    }
+
+    void rearm(void) {
+        m_trace_on = false;
+        // waiting for an assertion costs nothing per cycle
+        m_trace_armed = (m_trace != NULL) && !m_trace_on_assert;
+        select_tick();
+    }
+
+    void trace_update(void) {
+        if (!m_trace_on) {
+            if (m_tickcount < m_trace_start)
+                return;
+            if (m_trace_start_pred && !m_trace_start_pred(m_dut))
+                return;
+            m_trace_on = true;
+            if (m_trace_length != 0)
+                m_trace_stop = m_tickcount + m_trace_length;
+        }
+        if (m_tickcount >= m_trace_stop
+                || (m_trace_stop_pred && m_trace_stop_pred(m_dut))) {
+            // window is over, go back to the untraced tick
+            m_trace_on = false;
+            m_trace_armed = false;
+            select_tick();
+            m_trace->flush();
+        }
+    }
+
+    void traced_tick(void) {
+        trace_update();
+        if (m_trace_on) dump(10*m_tickcount-4);
+
+        // Toggle the clock
+        // Rising edge
+        m_dut->clk = 1;
+        m_dut->eval();
+        if (m_trace_on) dump(10*m_tickcount);
+
+        // Falling edge
+        m_dut->clk = 0;
+        m_dut->eval();
+        if (m_trace_on) {
+            dump(10*m_tickcount+5);
+            if (m_trace_flush != 0 && m_tickcount % m_trace_flush == 0)
+                m_trace->flush();
         }
     }
 };
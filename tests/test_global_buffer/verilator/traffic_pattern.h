@@ -0,0 +1,208 @@
+#ifndef TRAFFIC_PATTERN_H
+#define TRAFFIC_PATTERN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Cycle by cycle on/off pattern for a testbench driven control signal such
+// as glc_to_io_stall or a channel's cgra_to_io_wr_en. next() is called once
+// per cycle and returns the value for that cycle.
+class TRAFFIC_PATTERN {
+public:
+    virtual ~TRAFFIC_PATTERN(void) {}
+    virtual bool next(void) = 0;
+};
+
+class CONSTANT_PATTERN : public TRAFFIC_PATTERN {
+public:
+    CONSTANT_PATTERN(bool value) {
+        m_value = value;
+    }
+
+    bool next(void) {
+        return m_value;
+    }
+
+private:
+    bool m_value;
+};
+
+// On for length cycles from cycle start
+class WINDOW_PATTERN : public TRAFFIC_PATTERN {
+public:
+    WINDOW_PATTERN(unsigned long start, unsigned long length) {
+        m_start = start;
+        m_length = length;
+        m_cycle = 0;
+    }
+
+    bool next(void) {
+        unsigned long cycle = m_cycle++;
+        return cycle >= m_start && cycle - m_start < m_length;
+    }
+
+private:
+    unsigned long m_start;
+    unsigned long m_length;
+    unsigned long m_cycle;
+};
+
+// On for the first on cycles of every period, shifted by phase
+class PERIODIC_PATTERN : public TRAFFIC_PATTERN {
+public:
+    PERIODIC_PATTERN(unsigned long period, unsigned long on, unsigned long phase=0) {
+        m_period = period ? period : 1;
+        m_on = on;
+        m_cycle = phase;
+    }
+
+    bool next(void) {
+        return (m_cycle++ % m_period) < m_on;
+    }
+
+private:
+    unsigned long m_period;
+    unsigned long m_on;
+    unsigned long m_cycle;
+};
+
+// On with probability rate, independently every cycle
+class BERNOULLI_PATTERN : public TRAFFIC_PATTERN {
+public:
+    BERNOULLI_PATTERN(double rate, unsigned seed) : m_rng(seed), m_on(rate) {}
+
+    bool next(void) {
+        return m_on(m_rng);
+    }
+
+private:
+    std::mt19937                m_rng;
+    std::bernoulli_distribution m_on;
+};
+
+// Two state Markov chain which is on for a fraction rate of the cycles, in
+// bursts of burst cycles on average. With rate/(1 - rate) > burst the gaps
+// are a single cycle and the rate is lower.
+class BURSTY_PATTERN : public TRAFFIC_PATTERN {
+public:
+    BURSTY_PATTERN(double rate, double burst, unsigned seed)
+        : m_rng(seed),
+          m_leave_on(rate >= 1 ? 0 : burst > 1 ? 1 / burst : 1),
+          m_enter_on(rate >= 1 ? 1 : std::min(1.0, rate / (1 - rate) * (burst > 1 ? 1 / burst : 1))) {
+        m_state = false;
+    }
+
+    bool next(void) {
+        if (m_state)
+            m_state = !m_leave_on(m_rng);
+        else
+            m_state = m_enter_on(m_rng);
+        return m_state;
+    }
+
+private:
+    std::mt19937                m_rng;
+    std::bernoulli_distribution m_leave_on;
+    std::bernoulli_distribution m_enter_on;
+    bool                        m_state;
+};
+
+// Replays a file of '0'/'1' characters, one per cycle, over and over.
+// Everything else in the file is ignored.
+class TRACE_PATTERN : public TRAFFIC_PATTERN {
+public:
+    TRACE_PATTERN(const std::vector<bool> &values) {
+        m_values = values;
+        m_cycle = 0;
+    }
+
+    static bool load(const char *filename, std::vector<bool> &values) {
+        FILE *f = fopen(filename, "r");
+        if (f == NULL)
+            return false;
+        int c;
+        while ((c = fgetc(f)) != EOF) {
+            if (c == '0' || c == '1')
+                values.push_back(c == '1');
+        }
+        fclose(f);
+        return !values.empty();
+    }
+
+    bool next(void) {
+        return m_values[m_cycle++ % m_values.size()];
+    }
+
+private:
+    std::vector<bool>   m_values;
+    unsigned long       m_cycle;
+};
+
+// Pattern from a command line spec:
+//   off | on
+//   window:<start>:<length>
+//   periodic:<period>:<on>[:<phase>]
+//   bernoulli:<rate>
+//   bursty:<rate>:<mean burst length>
+//   trace:<file>
+// Random patterns are seeded with seed.
+inline TRAFFIC_PATTERN *make_traffic_pattern(const std::string &spec, unsigned seed) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = spec.find(':', start);
+        fields.push_back(spec.substr(start, end - start));
+        if (end == std::string::npos)
+            break;
+        start = end + 1;
+    }
+    const std::string &kind = fields[0];
+    try {
+        if (kind == "off" && fields.size() == 1)
+            return new CONSTANT_PATTERN(false);
+        if (kind == "on" && fields.size() == 1)
+            return new CONSTANT_PATTERN(true);
+        if (kind == "window" && fields.size() == 3)
+            return new WINDOW_PATTERN(std::stoul(fields[1]), std::stoul(fields[2]));
+        if (kind == "periodic" && (fields.size() == 3 || fields.size() == 4))
+            return new PERIODIC_PATTERN(std::stoul(fields[1]), std::stoul(fields[2]),
+                                        fields.size() == 4 ? std::stoul(fields[3]) : 0);
+        if (kind == "bernoulli" && fields.size() == 2)
+            return new BERNOULLI_PATTERN(std::stod(fields[1]), seed);
+        if (kind == "bursty" && fields.size() == 3)
+            return new BURSTY_PATTERN(std::stod(fields[1]), std::stod(fields[2]), seed);
+    }
+    catch (const std::exception &) {
+    }
+    if (kind == "trace" && fields.size() == 2) {
+        std::vector<bool> values;
+        if (TRACE_PATTERN::load(fields[1].c_str(), values))
+            return new TRACE_PATTERN(values);
+    }
+    std::cerr << std::endl;  // end the current line
+    std::cerr << "Traffic pattern " << spec << " is not valid" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// Cycles a channel was busy, and how many of them were stalled, to report
+// its effective throughput
+struct CHANNEL_LOAD {
+    unsigned long   busy_cycles;
+    unsigned long   stall_cycles;
+};
+
+inline void print_channel_throughput(uint16_t channel, unsigned long words, const CHANNEL_LOAD &load) {
+    if (load.busy_cycles == 0)
+        return;
+    printf("Channel %u: %lu words / %lu cycles / %.3f words per cycle / stall rate %.3f\n",
+           channel, words, load.busy_cycles, (double)words / load.busy_cycles,
+           (double)load.stall_cycles / load.busy_cycles);
+}
+
+#endif
@@ -1,33 +1,216 @@
+import contextlib
+import concurrent.futures
+import glob
+import hashlib
 import shutil
 import os
+import subprocess
+
+
+# Built models are kept in $VERILATOR_CACHE (default: .verilator_cache),
+# one directory per build key.
+CACHE_DIR = os.path.abspath(os.environ.get("VERILATOR_CACHE",
+                                           ".verilator_cache"))
+# Genesis output and traces of each configuration go to
+# $VERILATOR_WORK/<top>-<key> (default: verilator_work)
+WORK_DIR = os.path.abspath(os.environ.get("VERILATOR_WORK",
+                                          "verilator_work"))
+# C++ standard of the test drivers, for Verilated models and the C++
+# models alike
+CXX_STD = "c++14"
 
 
 def verilator_available():
     return shutil.which("verilator") is not None
 
 
-def run_verilator(params: dict, top, files, test_driver):
+@contextlib.contextmanager
+def work_dir(top, *config):
+    """
+    Runs the body in a directory of its own for every (top, config), so
+    that regressions running in parallel (e.g. pytest -n auto) do not
+    clobber each other's genesis_verif/ and traces. Yields the directory
+    the body was entered from, to resolve paths relative to it.
+    """
+    key = hashlib.sha256(repr(config).encode()).hexdigest()[:16]
+    path = os.path.join(WORK_DIR, f"{top}-{key}")
+    os.makedirs(path, exist_ok=True)
+    cwd = os.getcwd()
+    os.chdir(path)
+    try:
+        yield cwd
+    finally:
+        os.chdir(cwd)
+
+
+def compiler_available():
+    return shutil.which("c++") is not None
+
+
+def verilator_version():
+    return subprocess.check_output(["verilator", "--version"]).decode()
+
+
+def build_key(files, test_driver, verilator_cmd):
+    """
+    Hash of everything that goes into a built model: the RTL, the test
+    driver and the headers next to it, the verilator command line (which
+    holds the -G parameters) and the Verilator version.
+    """
+    h = hashlib.sha256()
+    h.update(verilator_version().encode())
+    h.update(verilator_cmd.encode())
+    headers = sorted(glob.glob(os.path.join(os.path.dirname(test_driver),
+                                            "*.h")))
+    for filename in list(files) + [test_driver] + headers:
+        h.update(os.path.basename(filename).encode())
+        with open(filename, "rb") as f:
+            h.update(f.read())
+    return h.hexdigest()
+
+
+def run_seeds(exe_cmd: list, seeds, jobs=None):
+    """
+    Runs exe_cmd once per seed with --seed, jobs processes at a time (one
+    per core by default). Each seed runs in seed_<n>/ so that traces and
+    logs do not collide. Returns the failing seeds.
+    """
+    def run_seed(seed):
+        seed_dir = f"seed_{seed}"
+        os.makedirs(seed_dir, exist_ok=True)
+        with open(os.path.join(seed_dir, "log"), "w") as log:
+            res = subprocess.run(exe_cmd + ["--seed", str(seed)],
+                                 cwd=seed_dir, stdout=log,
+                                 stderr=subprocess.STDOUT)
+        return seed, res.returncode == 0
+
+    seeds = list(seeds)
+    with concurrent.futures.ThreadPoolExecutor(
+            max_workers=jobs or os.cpu_count()) as pool:
+        results = list(pool.map(run_seed, seeds))
+    failed = [seed for seed, passed in results if not passed]
+    print(f"{len(seeds) - len(failed)}/{len(seeds)} seeds passed")
+    for seed in failed:
+        print(f"  seed {seed} failed, see {os.path.abspath(f'seed_{seed}')}"
+              f"/log. Replay with: {' '.join(exe_cmd)} --seed {seed}")
+    return failed
+
+
+def run_verilator(params: dict, top, files, test_driver, trace="vcd",
+                  trace_threads=0, threads=1, args={}, cache=True,
+                  seeds=None, log_level=None, savable=False):
+    """
+    threads > 1 builds a multithreaded model. trace selects the waveform
+    format the model is built for ("vcd" or "fst"). trace_threads > 0 moves
+    trace encoding to that many worker threads (FST only). args are harness
+    options passed to the test driver, e.g. {"--trace": 0}. With cache, an
+    executable built from the same inputs is reused instead of verilating
+    and compiling again. With seeds, the driver runs once per seed in
+    parallel (see run_seeds) and only passes if every seed passes.
+    log_level compiles out driver messages above that level (see tb_log.h).
+    savable builds a model that can be checkpointed (see TESTBENCH::save).
+    """
     if not verilator_available():
         raise Exception("Verilator not available")  # pragma: nocover
     if len(files) == 0:
         print("Warning: verilator requires at least 1 input file. \
               Skipping verilator.")
         return True
-    files_string = " ".join(files)
-    verilator_cmd = f"verilator {files_string} --top-module {top} -cc -O3 \
-            -Wno-fatal -exe {test_driver} --trace -CFLAGS \"-std=c++11\""
+    if trace == "fst":
+        trace_flags = "--trace-fst -CFLAGS \"-DTRACE_FST\""
+    elif trace == "vcd":
+        trace_flags = "--trace"
+    else:
+        raise ValueError(f"Unknown trace format {trace}")
+    if trace_threads > 0:
+        trace_flags += f" --trace-threads {trace_threads}"
+    thread_flags = ""
+    if threads > 1:
+        thread_flags = f"--threads {threads}"
+    log_flags = ""
+    if log_level is not None:
+        log_flags = f"-CFLAGS \"-DTB_LOG_LEVEL={log_level}\""
+    save_flags = ""
+    if savable:
+        save_flags = "--savable -CFLAGS \"-DTB_SAVABLE\""
     param_strs = [f"-G{k}='{str(v)}'"
                   for k, v in params.items()]
-    verilator_cmd = verilator_cmd + " " + " ".join(param_strs)
-    if not os.system(verilator_cmd) == 0:
-        return False
-    make_cmd = f"make -C ./obj_dir -f V{top}.mk"
-    if not os.system(make_cmd) == 0:
-        return False
+    verilator_flags = f"--top-module {top} -cc -O3 -Wno-fatal \
+            {trace_flags} {thread_flags} {log_flags} {save_flags} -CFLAGS \"-std={CXX_STD}\" " \
+        + " ".join(param_strs)
+    if cache:
+        key = build_key(files, test_driver, verilator_flags)
+        obj_dir = os.path.join(CACHE_DIR, key)
+    else:
+        obj_dir = "./obj_dir"
+    exe = os.path.abspath(os.path.join(obj_dir, f"V{top}"))
+    if not (cache and os.path.isfile(exe)):
+        # build somewhere private and move it in place once complete, so
+        # that a half built model is never picked up
+        build_dir = obj_dir + f".{os.getpid()}" if cache else obj_dir
+        files_string = " ".join(os.path.abspath(f) for f in files)
+        verilator_cmd = f"verilator {files_string} {verilator_flags} \
+                -exe {os.path.abspath(test_driver)} -Mdir {build_dir}"
+        make_cmd = f"make -j{os.cpu_count()} -C {build_dir} -f V{top}.mk"
+        built = False
+        try:
+            built = os.system(verilator_cmd) == 0 and \
+                os.system(make_cmd) == 0
+        finally:
+            # a failed build must not be left behind in the cache
+            if cache and not built:
+                shutil.rmtree(build_dir, ignore_errors=True)
+        if not built:
+            return False
+        if cache:
+            try:
+                os.rename(build_dir, obj_dir)
+            except OSError:
+                # somebody else built the same model in the meantime
+                shutil.rmtree(build_dir)
+    if seeds is not None:
+        exe_cmd = [exe]
+        for k, v in list(params.items()) + list(args.items()):
+            exe_cmd += [k, str(v)]
+        return len(run_seeds(exe_cmd, seeds)) == 0
     preprocessor_strs = [f"{k} '{str(v)}'"
                          for k, v in params.items()]
-    exe_cmd = f"./obj_dir/V{top} " + " ".join(preprocessor_strs)
+    arg_strs = [f"{k} '{str(v)}'"
+                for k, v in args.items()]
+    exe_cmd = f"{exe} " + " ".join(preprocessor_strs + arg_strs)
     if not os.system(exe_cmd) == 0:
         return False
 
     return True
+
+
+def run_model(test_driver, args={}, cache=True):
+    """
+    Builds and runs a driver of the C++ models (e.g. sweep_io_controller.cpp),
+    which needs a C++ compiler but no Verilator. args are passed to the
+    driver like in run_verilator. The executable is cached like a model.
+    """
+    h = hashlib.sha256()
+    headers = sorted(glob.glob(os.path.join(os.path.dirname(test_driver),
+                                            "*.h")))
+    for filename in [test_driver] + headers:
+        h.update(os.path.basename(filename).encode())
+        with open(filename, "rb") as f:
+            h.update(f.read())
+    obj_dir = os.path.join(CACHE_DIR, h.hexdigest()) if cache else "."
+    name = os.path.splitext(os.path.basename(test_driver))[0]
+    exe = os.path.abspath(os.path.join(obj_dir, name))
+    if not (cache and os.path.isfile(exe)):
+        os.makedirs(obj_dir, exist_ok=True)
+        build = exe + f".{os.getpid()}"
+        compile_cmd = f"c++ -O2 -std={CXX_STD} -o {build} " \
+            f"{os.path.abspath(test_driver)}"
+        if not os.system(compile_cmd) == 0:
+            if os.path.exists(build):
+                os.remove(build)
+            return False
+        os.replace(build, exe)
+    arg_strs = [f"{k} '{str(v)}'"
+                for k, v in args.items()]
+    exe_cmd = f"{exe} " + " ".join(arg_strs)
+    return os.system(exe_cmd) == 0